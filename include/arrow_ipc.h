@@ -0,0 +1,27 @@
+
+#ifndef ARROW_IPC_H
+#define ARROW_IPC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fills `count` values of a column, starting at row `start`, into `values`
+typedef void (*arrow_fill_callback)(void* values, size_t start, size_t count, void* data);
+
+// An integer column of an Arrow record batch, without nulls
+typedef struct {
+    const char* name;
+    uint8_t bit_width;
+    uint8_t is_signed;
+    arrow_fill_callback fill;
+    void* data;
+} arrow_column_t;
+
+typedef struct {
+    const char* key;
+    const char* value;
+} arrow_metadata_t;
+
+int write_arrow_ipc(const char* output_fn, const arrow_column_t* columns, size_t n_columns, size_t length, const arrow_metadata_t* metadata, size_t n_metadata);
+
+#endif
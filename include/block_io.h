@@ -0,0 +1,51 @@
+
+#ifndef BLOCK_IO_H
+#define BLOCK_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Maximum number of reads in flight at once
+#define BLOCK_IO_DEPTH 128
+
+// A read of `length` bytes at `offset` of a file into `buffer`. After block_io_read, `result` has the
+// number of bytes read, or a negative errno.
+typedef struct {
+    int fd;
+    uint64_t offset;
+    size_t length;
+    uint8_t* buffer;
+    ssize_t result;
+} block_read_t;
+
+// Batched reads through an io_uring when the kernel has one, or pread otherwise. The ring is set up with
+// raw system calls, so no liburing is needed.
+typedef struct {
+    int ring_fd;
+    unsigned depth;
+    uint8_t* sq_map;
+    size_t sq_map_size;
+    uint8_t* cq_map;
+    size_t cq_map_size;
+    void* sqes;
+    size_t sqes_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    void* cqes;
+} block_io_t;
+
+void block_io_init(block_io_t* io);
+
+int block_io_uses_uring(const block_io_t* io);
+
+int block_io_read(block_io_t* io, block_read_t* reads, size_t n_reads);
+
+void block_io_free(block_io_t* io);
+
+#endif
@@ -0,0 +1,18 @@
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed);
+
+int cache_lookup_file_hash(const char* cache_dir, const char* input_fn, uint64_t* content_hash);
+
+int cache_store_file_hash(const char* cache_dir, const char* input_fn, uint64_t content_hash);
+
+int64_t* cache_load_sa(const char* cache_dir, uint64_t key, size_t* sa_length);
+
+int cache_store_sa(const char* cache_dir, uint64_t key, const int64_t* sa, size_t sa_length);
+
+#endif
@@ -0,0 +1,13 @@
+
+#ifndef JOIN_H
+#define JOIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ssa_index.h"
+
+typedef void (*join_hit_callback)(int64_t position_a, int64_t position_b, size_t length, void* data);
+
+int64_t ssa_join(const ssa_index_t* a, const ssa_index_t* b, size_t min_length, join_hit_callback callback, void* data);
+
+#endif
@@ -0,0 +1,29 @@
+
+#ifndef LOCATE_H
+#define LOCATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "records.h"
+#include "search.h"
+#include "ssa_index.h"
+
+// Below this number of candidate suffixes, locating runs on the calling thread only
+#define LOCATE_PARALLEL_THRESHOLD (1 << 16)
+
+// The occurrences of a pattern sorted by position, grouped by record: the positions of group g are
+// positions[group_starts[g]] up to positions[group_starts[g + 1]], and they all lie in record records[g].
+// Without a record table, there are no groups. All arrays share one allocation.
+typedef struct {
+    int64_t* positions;
+    size_t n_positions;
+    size_t* group_starts;
+    uint32_t* records;
+    size_t n_groups;
+} locate_result_t;
+
+int ssa_locate(const ssa_index_t* index, const uint8_t* pattern, size_t pattern_len, search_strategy_t strategy, const record_table_t* records, int n_threads, locate_result_t* result);
+
+void locate_result_free(locate_result_t* result);
+
+#endif
@@ -0,0 +1,31 @@
+
+#ifndef MEMORY_PRESSURE_H
+#define MEMORY_PRESSURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Seconds between two checks while waiting for memory
+#define MEMORY_POLL_SECONDS 5
+
+// Memory that is left for the process, from the cgroup it runs in and the system as a whole. Page cache
+// that can be reclaimed without writing it back does not count as used.
+typedef struct {
+    uint64_t cgroup_limit;      // UINT64_MAX without a limit
+    uint64_t cgroup_usage;
+    uint64_t system_available;  // MemAvailable, UINT64_MAX if unknown
+    double pressure_some;       // PSI avg10 of the share of time some tasks stall on memory, -1 if unknown
+    double pressure_full;       // PSI avg10 of the share of time all tasks stall on memory, -1 if unknown
+} memory_status_t;
+
+void read_memory_status(memory_status_t* status);
+
+uint64_t available_memory(const memory_status_t* status);
+
+int wait_for_memory(uint64_t required, double max_pressure, unsigned max_wait_seconds);
+
+void* spill_to_file(const void* data, size_t size, const char* path_prefix);
+
+void free_spill(void* map, size_t size);
+
+#endif
@@ -0,0 +1,35 @@
+
+#ifndef MOTIF_H
+#define MOTIF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ssa_index.h"
+
+// A single motif position: a set of ranks repeated between min_repeat and max_repeat times,
+// or a run of fixed characters that is matched at once with packed comparisons.
+typedef struct {
+    uint64_t ranks[4];
+    uint8_t* literal;
+    size_t literal_len;
+    uint32_t min_repeat;
+    uint32_t max_repeat;
+} motif_element_t;
+
+typedef struct {
+    motif_element_t* elements;
+    size_t n_elements;
+    uint8_t anchored_start;
+    uint8_t anchored_end;
+    uint8_t matchable;
+} motif_t;
+
+typedef void (*motif_hit_callback)(int64_t position, size_t length, void* data);
+
+int motif_compile(const char* pattern, const ssa_index_t* index, motif_t* motif);
+
+void motif_free(motif_t* motif);
+
+size_t motif_search(const ssa_index_t* index, const motif_t* motif, motif_hit_callback callback, void* data);
+
+#endif
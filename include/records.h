@@ -0,0 +1,20 @@
+
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Start positions of the records of a text, followed by the length of the text as a sentinel
+typedef struct {
+    int64_t* offsets;
+    size_t n_records;
+} record_table_t;
+
+int build_record_table(const uint8_t* text, size_t text_len, record_table_t* table);
+
+size_t record_of(const record_table_t* table, int64_t position);
+
+void free_record_table(record_table_t* table);
+
+#endif
@@ -0,0 +1,22 @@
+
+#ifndef REPEATS_H
+#define REPEATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ssa_index.h"
+
+// A substring of the text, given by one of its occurrences, and its number of occurrences
+typedef struct {
+    int64_t position;
+    size_t length;
+    size_t count;
+} repeat_t;
+
+typedef void (*repeat_callback)(const repeat_t* repeat, void* data);
+
+int64_t ssa_enumerate_repeats(const ssa_index_t* index, size_t min_length, repeat_callback callback, void* data);
+
+int64_t ssa_top_frequent(const ssa_index_t* index, size_t length, size_t n, repeat_t* top);
+
+#endif
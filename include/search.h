@@ -0,0 +1,36 @@
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ssa_index.h"
+
+typedef enum {
+    SEARCH_BINARY,
+    SEARCH_LCP
+} search_strategy_t;
+
+// Maximum number of intervals of a search, one per offset below the sparseness factor, which fits a byte
+#define SEARCH_MAX_INTERVALS 256
+
+// Sampled suffixes in SA[lower, upper) start `offset` characters into a candidate occurrence
+typedef struct {
+    size_t lower;
+    size_t upper;
+    size_t offset;
+} search_interval_t;
+
+typedef void (*search_hit_callback)(int64_t position, void* data);
+
+size_t ssa_search_bound(const ssa_index_t* index, size_t lo, size_t hi, const uint8_t* pattern, size_t pattern_len, search_strategy_t strategy, size_t known_lcp, int upper);
+
+size_t ssa_search_intervals(const ssa_index_t* index, const uint8_t* pattern, size_t pattern_len, search_strategy_t strategy, search_interval_t* intervals);
+
+int ssa_verify_hit(const ssa_index_t* index, const uint8_t* pattern, size_t pattern_len, const search_interval_t* interval, int64_t suffix, int64_t* position);
+
+size_t ssa_search_tail(const ssa_index_t* index, const uint8_t* pattern, size_t pattern_len, search_hit_callback callback, void* data);
+
+size_t ssa_search(const ssa_index_t* index, const uint8_t* pattern, size_t pattern_len, search_strategy_t strategy, search_hit_callback callback, void* data);
+
+#endif
@@ -0,0 +1,60 @@
+
+#ifndef SSA_INDEX_H
+#define SSA_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Characters that separate records in the text
+#define SSA_SEPARATORS "-$"
+
+// Sections of memory whose page reads are counted by a trace: the SA payload and the text
+#define SSA_TRACE_SA 0
+#define SSA_TRACE_TEXT 1
+#define SSA_TRACE_SECTIONS 2
+
+// Reads of every page of the memory that holds the SA and the text of an index, counted by searches while
+// the trace is attached to the index. Reads outside the traced ranges are not counted. The counts are
+// updated without locks, so searches that run at the same time may lose a few.
+typedef struct {
+    const uint8_t* bases[SSA_TRACE_SECTIONS];
+    size_t sizes[SSA_TRACE_SECTIONS];
+    size_t page_size;
+    uint32_t* counts[SSA_TRACE_SECTIONS];
+} ssa_page_trace_t;
+
+// In-memory view of a (sparse) suffix array over its text. The SA payload is
+// kept in the layout produced by write_sa: plain 64-bit entries when
+// bits_per_element is 64, bitpacked words otherwise.
+typedef struct {
+    const uint8_t* text;
+    size_t text_len;
+    const uint8_t* sa;
+    size_t sa_length;
+    uint8_t bits_per_element;
+    uint8_t sparseness_factor;
+    uint8_t* char_to_rank;
+    uint8_t rank_to_char[256];
+    uint8_t alphabet_size;
+    ssa_page_trace_t* trace;
+} ssa_index_t;
+
+int ssa_index_init(ssa_index_t* index, const uint8_t* text, size_t text_len, const void* sa, size_t sa_length, uint8_t bits_per_element, uint8_t sparseness_factor);
+
+void ssa_index_free(ssa_index_t* index);
+
+int ssa_is_separator(uint8_t c);
+
+size_t ssa_separator_free_length(const uint8_t* s, size_t len);
+
+int64_t ssa_index_get(const ssa_index_t* index, size_t i);
+
+void ssa_trace_read(ssa_page_trace_t* trace, int section, const uint8_t* address, size_t length);
+
+void compress_sa(uint64_t* sa, size_t* sa_length, uint8_t bits_per_element);
+
+size_t packed_lcp(const uint8_t* a, size_t a_len, const uint8_t* b, size_t b_len);
+
+int packed_compare(const uint8_t* a, size_t a_len, const uint8_t* b, size_t b_len, size_t* lcp);
+
+#endif
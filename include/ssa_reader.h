@@ -0,0 +1,28 @@
+
+#ifndef SSA_READER_H
+#define SSA_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ssa_index.h"
+
+// Size of the header written by write_sa: bits per element, sparseness factor and SA length
+#define SSA_HEADER_SIZE (2 * sizeof(uint8_t) + sizeof(uint64_t))
+
+// An index opened from an SA file written by build_ssa and the text it was built on, both memory-mapped
+typedef struct {
+    ssa_index_t index;
+    uint8_t* sa_map;
+    size_t sa_map_size;
+    uint8_t* text_map;
+    size_t text_map_size;
+    uint8_t* strands_text;
+} ssa_reader_t;
+
+int ssa_reader_open(ssa_reader_t* reader, const char* sa_fn, const char* text_fn);
+
+int ssa_reader_open_strands(ssa_reader_t* reader, const char* sa_fn, const char* text_fn);
+
+void ssa_reader_close(ssa_reader_t* reader);
+
+#endif
@@ -0,0 +1,86 @@
+
+#ifndef SSD_INDEX_H
+#define SSD_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "block_io.h"
+#include "ssa_index.h"
+#include "windows.h"
+
+// Size of the blocks read from the SA and text files, aligned so the files can be opened with O_DIRECT
+#define SSD_BLOCK_SIZE 4096
+// Number of characters kept in RAM of every sampled suffix
+#define SSD_SAMPLE_PREFIX 16
+// Default number of suffixes in SA order per sampled suffix
+#define SSD_DEFAULT_SAMPLE_RATE 64
+
+// The part of an index that stays in RAM when its SA and text are read from disk: the header of the SA
+// file, the rank alphabet of the text, the bucket table of its q-grams and the first SSD_SAMPLE_PREFIX
+// characters of every sample_rate-th suffix in SA order. Sample s is SA[s * sample_rate], and its length
+// is that of the suffix, capped at SSD_SAMPLE_PREFIX + 1 so longer suffixes can be told apart.
+typedef struct {
+    uint8_t bits_per_element;
+    uint8_t sparseness_factor;
+    size_t sa_length;
+    size_t text_len;
+    uint8_t char_to_rank[256];
+    uint8_t rank_to_char[256];
+    uint8_t alphabet_size;
+    bucket_table_t buckets;
+    size_t sample_rate;
+    size_t n_samples;
+    uint8_t* sample_prefixes;
+    uint8_t* sample_lengths;
+} ssd_tier_t;
+
+// The blocks of the SA and text files read last, replaced with the clock algorithm. Blocks read in the
+// current round are never replaced, so every query finds the block it waited for.
+typedef struct {
+    size_t n_slots;
+    uint8_t* blocks;
+    uint64_t* keys;
+    size_t* lengths;
+    uint64_t* rounds;
+    uint8_t* referenced;
+    int32_t* next;
+    int32_t* heads;
+    size_t n_heads;
+    size_t hand;
+} block_cache_t;
+
+// An index whose SA and text are read from disk in blocks, with only its tier in RAM. Queries of a batch
+// run side by side: every round, each query runs until it needs a block that is not cached, and then the
+// missing blocks of all queries are read in one batch.
+typedef struct {
+    const ssd_tier_t* tier;
+    int sa_fd;
+    int text_fd;
+    size_t sa_file_size;
+    size_t text_file_size;
+    block_io_t io;
+    block_cache_t cache;
+    uint64_t round;
+    size_t blocks_read;
+    size_t cache_hits;
+} ssd_index_t;
+
+typedef void (*ssd_hit_callback)(size_t query, int64_t position, void* data);
+
+int ssd_tier_build(ssd_tier_t* tier, const ssa_index_t* index, size_t sample_rate);
+
+int ssd_tier_write(const ssd_tier_t* tier, const char* output_fn);
+
+int ssd_tier_load(ssd_tier_t* tier, const char* input_fn);
+
+size_t ssd_tier_size(const ssd_tier_t* tier);
+
+void ssd_tier_free(ssd_tier_t* tier);
+
+int ssd_index_open(ssd_index_t* ssd, const ssd_tier_t* tier, const char* sa_fn, const char* text_fn, size_t cache_blocks);
+
+int ssd_search_batch(ssd_index_t* ssd, const uint8_t* const* patterns, const size_t* pattern_lens, size_t n_patterns, ssd_hit_callback callback, void* data, size_t* hits);
+
+void ssd_index_close(ssd_index_t* ssd);
+
+#endif
@@ -0,0 +1,23 @@
+
+#ifndef STRANDS_H
+#define STRANDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "records.h"
+
+// A hit in a text with both strands, in the coordinates of the forward strand: the match starts `offset`
+// characters into the original record, on the reverse strand if `reverse` is set
+typedef struct {
+    size_t record;
+    int reverse;
+    int64_t offset;
+} strand_hit_t;
+
+uint8_t complement_dna(uint8_t c);
+
+uint8_t* add_reverse_complements(const uint8_t* text, size_t text_len, size_t* both_len);
+
+void strand_hit(const record_table_t* table, int64_t position, size_t pattern_len, strand_hit_t* hit);
+
+#endif
@@ -0,0 +1,39 @@
+
+#ifndef SUBSET_H
+#define SUBSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "records.h"
+
+// A line of a FASTA index (.fai, as written by samtools faidx): the sequence of record `name` has
+// `length` characters and starts at byte `offset`, in lines of `line_bases` characters that take
+// `line_width` bytes with their line end
+typedef struct {
+    char* name;
+    uint64_t length;
+    uint64_t offset;
+    uint64_t line_bases;
+    uint64_t line_width;
+} fai_entry_t;
+
+// The records of a FASTA index, sorted by name
+typedef struct {
+    fai_entry_t* entries;
+    size_t n_entries;
+    char* names;
+} fasta_index_t;
+
+int read_fasta_index(const char* fai_fn, fasta_index_t* index);
+
+void free_fasta_index(fasta_index_t* index);
+
+const fai_entry_t* find_fasta_record(const fasta_index_t* index, const char* name);
+
+char** read_id_list(const char* ids_fn, size_t* n_ids);
+
+void free_id_list(char** ids, size_t n_ids);
+
+uint8_t* gather_records(const char* fasta_fn, const fasta_index_t* index, char** ids, size_t n_ids, size_t* length, record_table_t* records);
+
+#endif
@@ -0,0 +1,46 @@
+
+#ifndef TEXT_STORE_H
+#define TEXT_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of characters per independently decodable block
+#define TEXT_STORE_BLOCK_SIZE 256
+// Number of blocks per superblock, few enough that a bit offset within a superblock fits 16 bits
+#define TEXT_STORE_BLOCKS_PER_SUPERBLOCK 16
+// Maximum length of a code, so every code can be decoded with a single table lookup
+#define TEXT_STORE_MAX_CODE_LENGTH 12
+
+// A text compressed with a canonical Huffman code in blocks of TEXT_STORE_BLOCK_SIZE characters. The
+// bit offset of every block is stored, so any substring is decoded starting from the block it starts in.
+// Offsets take two levels: a 64-bit offset per superblock, followed by the total number of bits, and a
+// 16-bit offset per block relative to its superblock.
+typedef struct {
+    size_t text_len;
+    uint8_t* bits;
+    size_t bits_size;
+    uint64_t* superblock_offsets;
+    size_t n_superblocks;
+    uint16_t* block_offsets;
+    size_t n_blocks;
+    uint8_t code_lengths[256];
+    uint16_t codes[256];
+    uint16_t* decode_table;
+} text_store_t;
+
+int text_store_build(text_store_t* store, const uint8_t* text, size_t text_len);
+
+int text_store_write(const text_store_t* store, const char* output_fn);
+
+int text_store_load(text_store_t* store, const char* input_fn);
+
+void text_store_free(text_store_t* store);
+
+size_t text_store_size(const text_store_t* store);
+
+size_t text_store_extract(const text_store_t* store, size_t position, size_t len, uint8_t* out);
+
+int text_store_compare(const text_store_t* store, size_t position, const uint8_t* pattern, size_t pattern_len, size_t* lcp);
+
+#endif
@@ -0,0 +1,25 @@
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// Static tracepoints (USDT) for tools such as bpftrace, perf and SystemTap, e.g.
+//   bpftrace -e 'usdt:./libsais-packed:libsais64:recursion_entry { printf("%d %d\n", arg0, arg1); }'
+// A disabled probe compiles to a single nop, so builds always include them when <sys/sdt.h> is available.
+// Without it, the probes compile to nothing.
+#if defined(HAVE_SYS_SDT_H)
+    #include <sys/sdt.h>
+
+    #define TRACE_PROBE0(provider, name) DTRACE_PROBE(provider, name)
+    #define TRACE_PROBE1(provider, name, a1) DTRACE_PROBE1(provider, name, a1)
+    #define TRACE_PROBE2(provider, name, a1, a2) DTRACE_PROBE2(provider, name, a1, a2)
+    #define TRACE_PROBE3(provider, name, a1, a2, a3) DTRACE_PROBE3(provider, name, a1, a2, a3)
+    #define TRACE_PROBE4(provider, name, a1, a2, a3, a4) DTRACE_PROBE4(provider, name, a1, a2, a3, a4)
+#else
+    #define TRACE_PROBE0(provider, name) do { } while (0)
+    #define TRACE_PROBE1(provider, name, a1) do { } while (0)
+    #define TRACE_PROBE2(provider, name, a1, a2) do { } while (0)
+    #define TRACE_PROBE3(provider, name, a1, a2, a3) do { } while (0)
+    #define TRACE_PROBE4(provider, name, a1, a2, a3, a4) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+
+#ifndef WARMUP_H
+#define WARMUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ssa_reader.h"
+
+// Sections of a reader whose pages are profiled: the mapped SA file and the mapped text file, in the order
+// of the sections of a page trace
+#define ACCESS_PROFILE_SECTIONS SSA_TRACE_SECTIONS
+
+// The pages of one mapped file that were read by searches while a profile was recorded, as bitmaps with
+// one bit per page. Hot pages are the most read ones, which together take half of all reads.
+typedef struct {
+    size_t map_size;
+    size_t n_pages;
+    uint8_t* used;
+    uint8_t* hot;
+} access_section_t;
+
+// Which pages of an index are read under live traffic, counted by a page trace attached to the index of
+// a reader while it serves queries, and replayed when the index is opened again
+typedef struct {
+    size_t page_size;
+    ssa_page_trace_t trace;
+    ssa_reader_t* reader;
+    access_section_t sections[ACCESS_PROFILE_SECTIONS];
+} access_profile_t;
+
+int access_profile_init(access_profile_t* profile, ssa_reader_t* reader);
+
+int access_profile_update(access_profile_t* profile);
+
+int access_profile_write(const access_profile_t* profile, const char* output_fn);
+
+int access_profile_load(access_profile_t* profile, const char* input_fn, const ssa_reader_t* reader);
+
+size_t access_profile_prefetch(const access_profile_t* profile, const ssa_reader_t* reader, int n_threads);
+
+void access_profile_free(access_profile_t* profile);
+
+#endif
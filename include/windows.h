@@ -0,0 +1,38 @@
+
+#ifndef WINDOWS_H
+#define WINDOWS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "search.h"
+#include "ssa_index.h"
+
+// Maximum number of buckets of a bucket table, which keeps the table at a few MB
+#define BUCKET_TABLE_MAX_BUCKETS (1 << 20)
+
+// The SA intervals of all q-grams of the text. The key of a q-gram has the ranks of its characters as
+// digits in base alphabet_size, and starts[g] counts the sampled suffixes of at least q characters with
+// a smaller key. The text positions of the at most q sampled suffixes that are shorter are kept apart,
+// with a copy of their characters (q bytes each) so intervals can be found without the text.
+typedef struct {
+    size_t q;
+    size_t alphabet_size;
+    size_t n_buckets;
+    size_t* starts;
+    size_t* short_suffixes;
+    uint8_t* short_texts;
+    size_t n_short;
+    size_t text_len;
+} bucket_table_t;
+
+typedef void (*window_hit_callback)(size_t window, int64_t position, void* data);
+
+int bucket_table_build(const ssa_index_t* index, bucket_table_t* table);
+
+void bucket_table_free(bucket_table_t* table);
+
+void bucket_table_interval(const bucket_table_t* table, size_t key, const uint8_t* prefix, size_t prefix_len, search_interval_t* interval);
+
+size_t ssa_search_windows(const ssa_index_t* index, const bucket_table_t* table, const uint8_t* sequence, size_t sequence_len, size_t window_len, window_hit_callback callback, void* data);
+
+#endif
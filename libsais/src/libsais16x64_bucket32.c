@@ -0,0 +1,9 @@
+/*--
+
+This file builds the variant of libsais16x64.c with 32-bit bucket counters, which libsais16x64
+uses for inputs of at most INT32_MAX symbols when LIBSAIS_DISPATCH_BUCKET32 is defined.
+
+--*/
+
+#define LIBSAIS_BUCKET32
+#include "libsais16x64.c"
@@ -26,6 +26,7 @@ Modifications made by team Unipept as of 18/10/2024 and ongoing.
 --*/
 
 #include "libsais64.h"
+#include "trace.h"
 
 #include <stddef.h>
 #include <stdint.h>
@@ -38,6 +39,14 @@ typedef uint64_t                        sa_uint_t;
 typedef int64_t                         fast_sint_t;
 typedef uint64_t                        fast_uint_t;
 
+/* Bucket counters of the top-level alphabet. With LIBSAIS_BUCKET32 this file builds a variant with 32-bit
+   counters, which halves the bucket memory for texts of less than 2^31 symbols (see libsais64_bucket32.c). */
+#if defined(LIBSAIS_BUCKET32)
+typedef int32_t                         sa_bucket_t;
+#else
+typedef int64_t                         sa_bucket_t;
+#endif
+
 #define SAINT_BIT                       (64)
 #define SAINT_MAX                       INT64_MAX
 #define SAINT_MIN                       INT64_MIN
@@ -328,9 +337,9 @@ static void libsais64_count_lms_suffixes_32s_2k(const sa_sint_t * RESTRICT T, sa
     buckets[BUCKETS_INDEX2((fast_uint_t)c0, 0)]++;
 }
 
-static sa_sint_t libsais64_count_and_gather_lms_suffixes_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
+static sa_sint_t libsais64_count_and_gather_lms_suffixes_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_bucket_t * RESTRICT buckets, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
 {
-    memset(buckets, 0, (size_t)4 * ALPHABET_SIZE * sizeof(sa_sint_t));
+    memset(buckets, 0, (size_t)4 * ALPHABET_SIZE * sizeof(sa_bucket_t));
 
     fast_sint_t m = omp_block_start + omp_block_size - 1;
 
@@ -374,7 +383,7 @@ static sa_sint_t libsais64_count_and_gather_lms_suffixes_8u(const uint8_t * REST
     return (sa_sint_t)(omp_block_start + omp_block_size - 1 - m);
 }
 
-static sa_sint_t libsais64_count_and_gather_lms_suffixes_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t * RESTRICT buckets)
+static sa_sint_t libsais64_count_and_gather_lms_suffixes_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_bucket_t * RESTRICT buckets)
 {
     sa_sint_t m = 0;
 
@@ -599,10 +608,10 @@ static void libsais64_count_suffixes_32s(const sa_sint_t * RESTRICT T, sa_sint_t
     }
 }
 
-static sa_sint_t libsais64_initialize_buckets_start_and_end_8u(sa_sint_t * RESTRICT buckets, sa_sint_t * RESTRICT freq)
+static sa_sint_t libsais64_initialize_buckets_start_and_end_8u(sa_bucket_t * RESTRICT buckets, sa_sint_t * RESTRICT freq)
 {
-    sa_sint_t * RESTRICT bucket_start = &buckets[6 * ALPHABET_SIZE];
-    sa_sint_t * RESTRICT bucket_end   = &buckets[7 * ALPHABET_SIZE];
+    sa_bucket_t * RESTRICT bucket_start = &buckets[6 * ALPHABET_SIZE];
+    sa_bucket_t * RESTRICT bucket_end   = &buckets[7 * ALPHABET_SIZE];
 
     fast_sint_t k = -1;
 
@@ -670,7 +679,7 @@ static void libsais64_initialize_buckets_end_32s_1k(sa_sint_t k, sa_sint_t * RES
     for (i = 0; i <= (fast_sint_t)k - 1; i += 1) { sum += buckets[i]; buckets[i] = sum; }
 }
 
-static sa_sint_t libsais64_initialize_buckets_for_lms_suffixes_radix_sort_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix)
+static sa_sint_t libsais64_initialize_buckets_for_lms_suffixes_radix_sort_8u(const uint8_t * RESTRICT T, sa_bucket_t * RESTRICT buckets, sa_sint_t first_lms_suffix)
 {
     {
         fast_uint_t     s = 0;
@@ -687,7 +696,7 @@ static sa_sint_t libsais64_initialize_buckets_for_lms_suffixes_radix_sort_8u(con
     }
 
     {
-        sa_sint_t * RESTRICT temp_bucket = &buckets[4 * ALPHABET_SIZE];
+        sa_bucket_t * RESTRICT temp_bucket = &buckets[4 * ALPHABET_SIZE];
 
         fast_sint_t i, j; sa_sint_t sum = 0;
         for (i = BUCKETS_INDEX4(0, 0), j = BUCKETS_INDEX2(0, 0); i <= BUCKETS_INDEX4(ALPHABET_SIZE - 1, 0); i += BUCKETS_INDEX4(1, 0), j += BUCKETS_INDEX2(1, 0))
@@ -728,7 +737,7 @@ static sa_sint_t libsais64_initialize_buckets_for_lms_suffixes_radix_sort_32s_6k
     }
 }
 
-static void libsais64_radix_sort_lms_suffixes_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
+static void libsais64_radix_sort_lms_suffixes_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_bucket_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
 {
     const fast_sint_t prefetch_distance = 32;
 
@@ -754,7 +763,7 @@ static void libsais64_radix_sort_lms_suffixes_8u(const uint8_t * RESTRICT T, sa_
     }
 }
 
-static void libsais64_radix_sort_lms_suffixes_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m, sa_sint_t * RESTRICT buckets)
+static void libsais64_radix_sort_lms_suffixes_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m, sa_bucket_t * RESTRICT buckets)
 {
     libsais64_radix_sort_lms_suffixes_8u(T, SA, &buckets[4 * ALPHABET_SIZE], (fast_sint_t)n - (fast_sint_t)m + 1, (fast_sint_t)m - 1);
 }
@@ -876,9 +885,9 @@ static void libsais64_radix_sort_set_markers_32s_6k_omp(sa_sint_t * RESTRICT SA,
     libsais64_radix_sort_set_markers_32s_6k(SA, induction_bucket, omp_block_start, omp_block_size);
 }
 
-static void libsais64_initialize_buckets_for_partial_sorting_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count)
+static void libsais64_initialize_buckets_for_partial_sorting_8u(const uint8_t * RESTRICT T, sa_bucket_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count)
 {
-    sa_sint_t * RESTRICT temp_bucket = &buckets[4 * ALPHABET_SIZE];
+    sa_bucket_t * RESTRICT temp_bucket = &buckets[4 * ALPHABET_SIZE];
 
     buckets[BUCKETS_INDEX4((fast_uint_t)T[first_lms_suffix], 1)]++;
 
@@ -937,12 +946,12 @@ static void libsais64_initialize_buckets_for_partial_sorting_32s_6k(const sa_sin
     }
 }
 
-static sa_sint_t libsais64_partial_sorting_scan_left_to_right_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t * RESTRICT buckets, sa_sint_t d, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
+static sa_sint_t libsais64_partial_sorting_scan_left_to_right_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_bucket_t * RESTRICT buckets, sa_sint_t d, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
 {
     const fast_sint_t prefetch_distance = 32;
 
-    sa_sint_t * RESTRICT induction_bucket = &buckets[4 * ALPHABET_SIZE];
-    sa_sint_t * RESTRICT distinct_names   = &buckets[2 * ALPHABET_SIZE];
+    sa_bucket_t * RESTRICT induction_bucket = &buckets[4 * ALPHABET_SIZE];
+    sa_bucket_t * RESTRICT distinct_names   = &buckets[2 * ALPHABET_SIZE];
 
     fast_sint_t i, j;
     for (i = omp_block_start, j = omp_block_start + omp_block_size - prefetch_distance - 1; i < j; i += 2)
@@ -970,10 +979,10 @@ static sa_sint_t libsais64_partial_sorting_scan_left_to_right_8u(const uint8_t *
     return d;
 }
 
-static sa_sint_t libsais64_partial_sorting_scan_left_to_right_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t left_suffixes_count, sa_sint_t d)
+static sa_sint_t libsais64_partial_sorting_scan_left_to_right_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_bucket_t * RESTRICT buckets, sa_sint_t left_suffixes_count, sa_sint_t d)
 {
-    sa_sint_t * RESTRICT induction_bucket = &buckets[4 * ALPHABET_SIZE];
-    sa_sint_t * RESTRICT distinct_names   = &buckets[2 * ALPHABET_SIZE];
+    sa_bucket_t * RESTRICT induction_bucket = &buckets[4 * ALPHABET_SIZE];
+    sa_bucket_t * RESTRICT distinct_names   = &buckets[2 * ALPHABET_SIZE];
 
     SA[induction_bucket[BUCKETS_INDEX2(T[n - 1], T[n - 2] >= T[n - 1])]++] = (n - 1) | SAINT_MIN;
     distinct_names[BUCKETS_INDEX2(T[n - 1], T[n - 2] >= T[n - 1])] = ++d;
@@ -1057,11 +1066,11 @@ static void libsais64_partial_sorting_scan_left_to_right_32s_1k_omp(const sa_sin
     libsais64_partial_sorting_scan_left_to_right_32s_1k(T, SA, buckets, 0, n);
 }
 
-static void libsais64_partial_sorting_shift_markers_8u_omp(sa_sint_t * RESTRICT SA, sa_sint_t n, const sa_sint_t * RESTRICT buckets)
+static void libsais64_partial_sorting_shift_markers_8u_omp(sa_sint_t * RESTRICT SA, sa_sint_t n, const sa_bucket_t * RESTRICT buckets)
 {
     const fast_sint_t prefetch_distance = 32;
 
-    const sa_sint_t * RESTRICT temp_bucket = &buckets[4 * ALPHABET_SIZE];
+    const sa_bucket_t * RESTRICT temp_bucket = &buckets[4 * ALPHABET_SIZE];
 
     fast_sint_t c;
 
@@ -1125,12 +1134,12 @@ static void libsais64_partial_sorting_shift_buckets_32s_6k(sa_sint_t k, sa_sint_
     }
 }
 
-static sa_sint_t libsais64_partial_sorting_scan_right_to_left_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t * RESTRICT buckets, sa_sint_t d, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
+static sa_sint_t libsais64_partial_sorting_scan_right_to_left_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_bucket_t * RESTRICT buckets, sa_sint_t d, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
 {
     const fast_sint_t prefetch_distance = 32;
 
-    sa_sint_t * RESTRICT induction_bucket = &buckets[0 * ALPHABET_SIZE];
-    sa_sint_t * RESTRICT distinct_names   = &buckets[2 * ALPHABET_SIZE];
+    sa_bucket_t * RESTRICT induction_bucket = &buckets[0 * ALPHABET_SIZE];
+    sa_bucket_t * RESTRICT distinct_names   = &buckets[2 * ALPHABET_SIZE];
 
     fast_sint_t i, j;
     for (i = omp_block_start + omp_block_size - 1, j = omp_block_start + prefetch_distance + 1; i >= j; i -= 2)
@@ -1158,7 +1167,7 @@ static sa_sint_t libsais64_partial_sorting_scan_right_to_left_8u(const uint8_t *
     return d;
 }
 
-static void libsais64_partial_sorting_scan_right_to_left_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count, sa_sint_t d)
+static void libsais64_partial_sorting_scan_right_to_left_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_bucket_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count, sa_sint_t d)
 {
     fast_sint_t scan_start    = (fast_sint_t)left_suffixes_count + 1;
     fast_sint_t scan_end      = (fast_sint_t)n - (fast_sint_t)first_lms_suffix;
@@ -1269,9 +1278,9 @@ static void libsais64_partial_sorting_gather_lms_suffixes_32s_1k_omp(sa_sint_t *
     libsais64_partial_sorting_gather_lms_suffixes_32s_1k(SA, omp_block_start, omp_block_size);
 }
 
-static void libsais64_induce_partial_order_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count)
+static void libsais64_induce_partial_order_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_bucket_t * RESTRICT buckets, sa_sint_t first_lms_suffix, sa_sint_t left_suffixes_count)
 {
-    memset(&buckets[2 * ALPHABET_SIZE], 0, (size_t)2 * ALPHABET_SIZE * sizeof(sa_sint_t));
+    memset(&buckets[2 * ALPHABET_SIZE], 0, (size_t)2 * ALPHABET_SIZE * sizeof(sa_bucket_t));
 
     sa_sint_t d = libsais64_partial_sorting_scan_left_to_right_8u_omp(T, SA, n, k, buckets, left_suffixes_count, 0);
     libsais64_partial_sorting_shift_markers_8u_omp(SA, n, buckets);
@@ -1624,9 +1633,9 @@ static void libsais64_reconstruct_lms_suffixes_omp(sa_sint_t * RESTRICT SA, sa_s
     libsais64_reconstruct_lms_suffixes(SA, n, m, omp_block_start, omp_block_size);
 }
 
-static void libsais64_place_lms_suffixes_interval_8u(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m, const sa_sint_t * RESTRICT buckets)
+static void libsais64_place_lms_suffixes_interval_8u(sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t m, const sa_bucket_t * RESTRICT buckets)
 {
-    const sa_sint_t * RESTRICT bucket_end = &buckets[7 * ALPHABET_SIZE];
+    const sa_bucket_t * RESTRICT bucket_end = &buckets[7 * ALPHABET_SIZE];
 
     fast_sint_t c, j = n;
     for (c = ALPHABET_SIZE - 2; c >= 0; --c)
@@ -1721,7 +1730,7 @@ static void libsais64_place_lms_suffixes_histogram_32s_4k(sa_sint_t * RESTRICT S
     memset(&SA[0], 0, (size_t)j * sizeof(sa_sint_t));
 }
 
-static void libsais64_final_bwt_scan_left_to_right_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
+static void libsais64_final_bwt_scan_left_to_right_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_bucket_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
 {
     const fast_sint_t prefetch_distance = 32;
 
@@ -1743,7 +1752,7 @@ static void libsais64_final_bwt_scan_left_to_right_8u(const uint8_t * RESTRICT T
     }
 }
 
-static void libsais64_final_bwt_aux_scan_left_to_right_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t rm, sa_sint_t * RESTRICT I, sa_sint_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
+static void libsais64_final_bwt_aux_scan_left_to_right_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t rm, sa_sint_t * RESTRICT I, sa_bucket_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
 {
     const fast_sint_t prefetch_distance = 32;
 
@@ -1765,7 +1774,7 @@ static void libsais64_final_bwt_aux_scan_left_to_right_8u(const uint8_t * RESTRI
     }
 }
 
-static void libsais64_final_sorting_scan_left_to_right_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
+static void libsais64_final_sorting_scan_left_to_right_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_bucket_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
 {
     const fast_sint_t prefetch_distance = 32;
 
@@ -1811,14 +1820,14 @@ static void libsais64_final_sorting_scan_left_to_right_32s(const sa_sint_t * RES
     }
 }
 
-static void libsais64_final_bwt_scan_left_to_right_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, fast_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT induction_bucket)
+static void libsais64_final_bwt_scan_left_to_right_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, fast_sint_t n, sa_sint_t k, sa_bucket_t * RESTRICT induction_bucket)
 {
     SA[induction_bucket[T[(sa_sint_t)n - 1]]++] = ((sa_sint_t)n - 1) | ((sa_sint_t)(T[(sa_sint_t)n - 2] < T[(sa_sint_t)n - 1]) << (SAINT_BIT - 1));
 
     libsais64_final_bwt_scan_left_to_right_8u(T, SA, induction_bucket, 0, n);
 }
 
-static void libsais64_final_bwt_aux_scan_left_to_right_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, fast_sint_t n, sa_sint_t k, sa_sint_t rm, sa_sint_t * RESTRICT I, sa_sint_t * RESTRICT induction_bucket)
+static void libsais64_final_bwt_aux_scan_left_to_right_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, fast_sint_t n, sa_sint_t k, sa_sint_t rm, sa_sint_t * RESTRICT I, sa_bucket_t * RESTRICT induction_bucket)
 {
     SA[induction_bucket[T[(sa_sint_t)n - 1]]++] = ((sa_sint_t)n - 1) | ((sa_sint_t)(T[(sa_sint_t)n - 2] < T[(sa_sint_t)n - 1]) << (SAINT_BIT - 1));
 
@@ -1827,7 +1836,7 @@ static void libsais64_final_bwt_aux_scan_left_to_right_8u_omp(const uint8_t * RE
     libsais64_final_bwt_aux_scan_left_to_right_8u(T, SA, rm, I, induction_bucket, 0, n);
 }
 
-static void libsais64_final_sorting_scan_left_to_right_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, fast_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT induction_bucket)
+static void libsais64_final_sorting_scan_left_to_right_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, fast_sint_t n, sa_sint_t k, sa_bucket_t * RESTRICT induction_bucket)
 {
     SA[induction_bucket[T[(sa_sint_t)n - 1]]++] = ((sa_sint_t)n - 1) | ((sa_sint_t)(T[(sa_sint_t)n - 2] < T[(sa_sint_t)n - 1]) << (SAINT_BIT - 1));
 
@@ -1841,7 +1850,7 @@ static void libsais64_final_sorting_scan_left_to_right_32s_omp(const sa_sint_t *
     libsais64_final_sorting_scan_left_to_right_32s(T, SA, induction_bucket, 0, n);
 }
 
-static sa_sint_t libsais64_final_bwt_scan_right_to_left_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
+static sa_sint_t libsais64_final_bwt_scan_right_to_left_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_bucket_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
 {
     const fast_sint_t prefetch_distance = 32;
 
@@ -1869,7 +1878,7 @@ static sa_sint_t libsais64_final_bwt_scan_right_to_left_8u(const uint8_t * RESTR
     return index;
 }
 
-static void libsais64_final_bwt_aux_scan_right_to_left_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t rm, sa_sint_t * RESTRICT I, sa_sint_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
+static void libsais64_final_bwt_aux_scan_right_to_left_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t rm, sa_sint_t * RESTRICT I, sa_bucket_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
 {
     const fast_sint_t prefetch_distance = 32;
 
@@ -1895,7 +1904,7 @@ static void libsais64_final_bwt_aux_scan_right_to_left_8u(const uint8_t * RESTRI
     }
 }
 
-static void libsais64_final_sorting_scan_right_to_left_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
+static void libsais64_final_sorting_scan_right_to_left_8u(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_bucket_t * RESTRICT induction_bucket, fast_sint_t omp_block_start, fast_sint_t omp_block_size)
 {
     const fast_sint_t prefetch_distance = 32;
 
@@ -1941,7 +1950,7 @@ static void libsais64_final_sorting_scan_right_to_left_32s(const sa_sint_t * RES
     }
 }
 
-static sa_sint_t libsais64_final_bwt_scan_right_to_left_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT induction_bucket)
+static sa_sint_t libsais64_final_bwt_scan_right_to_left_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_bucket_t * RESTRICT induction_bucket)
 {
     sa_sint_t index = -1;
 
@@ -1950,12 +1959,12 @@ static sa_sint_t libsais64_final_bwt_scan_right_to_left_8u_omp(const uint8_t * R
     return index;
 }
 
-static void libsais64_final_bwt_aux_scan_right_to_left_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t rm, sa_sint_t * RESTRICT I, sa_sint_t * RESTRICT induction_bucket)
+static void libsais64_final_bwt_aux_scan_right_to_left_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t rm, sa_sint_t * RESTRICT I, sa_bucket_t * RESTRICT induction_bucket)
 {
     libsais64_final_bwt_aux_scan_right_to_left_8u(T, SA, rm, I, induction_bucket, 0, n);
 }
 
-static void libsais64_final_sorting_scan_right_to_left_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t * RESTRICT induction_bucket)
+static void libsais64_final_sorting_scan_right_to_left_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_bucket_t * RESTRICT induction_bucket)
 {
     libsais64_final_sorting_scan_right_to_left_8u(T, SA, induction_bucket, 0, n);
 }
@@ -1978,7 +1987,7 @@ static void libsais64_clear_lms_suffixes_omp(sa_sint_t * RESTRICT SA, sa_sint_t
     }
 }
 
-static sa_sint_t libsais64_induce_final_order_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t bwt, sa_sint_t r, sa_sint_t * RESTRICT I, sa_sint_t * RESTRICT buckets)
+static sa_sint_t libsais64_induce_final_order_8u_omp(const uint8_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t bwt, sa_sint_t r, sa_sint_t * RESTRICT I, sa_bucket_t * RESTRICT buckets)
 {
     if (!bwt)
     {
@@ -2224,7 +2233,9 @@ static void libsais64_reconstruct_compacted_lms_suffixes_32s_1k_omp(sa_sint_t *
     }
 }
 
-static sa_sint_t libsais64_main_32s_recursion(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t fs, sa_sint_t * RESTRICT local_buffer)
+static sa_sint_t libsais64_main_32s_recursion(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t fs, sa_sint_t * RESTRICT local_buffer);
+
+static sa_sint_t libsais64_main_32s_recursion_body(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t fs, sa_sint_t * RESTRICT local_buffer)
 {
     fs = fs < (SAINT_MAX - n) ? fs : (SAINT_MAX - n);
 
@@ -2259,6 +2270,8 @@ static sa_sint_t libsais64_main_32s_recursion(sa_sint_t * RESTRICT T, sa_sint_t
                     ? libsais64_compact_lms_suffixes_32s_omp(T, SA, n, m, fs)
                     : 0;
 
+                TRACE_PROBE4(libsais64, recursion_reduce, n, m, names, fs);
+
                 if (libsais64_main_32s_recursion(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f, local_buffer) != 0)
                 {
                     return -2;
@@ -2312,6 +2325,8 @@ static sa_sint_t libsais64_main_32s_recursion(sa_sint_t * RESTRICT T, sa_sint_t
 
                 sa_sint_t f = libsais64_compact_lms_suffixes_32s_omp(T, SA, n, m, fs);
 
+                TRACE_PROBE4(libsais64, recursion_reduce, n, m, names, fs);
+
                 if (libsais64_main_32s_recursion(SA + n + fs - m + f, SA, m - f, names - f, fs + n - 2 * m + f, local_buffer) != 0)
                 {
                     return -2;
@@ -2335,6 +2350,17 @@ static sa_sint_t libsais64_main_32s_recursion(sa_sint_t * RESTRICT T, sa_sint_t
     }
 }
 
+static sa_sint_t libsais64_main_32s_recursion(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t fs, sa_sint_t * RESTRICT local_buffer)
+{
+    TRACE_PROBE3(libsais64, recursion_entry, n, k, fs);
+
+    sa_sint_t result = libsais64_main_32s_recursion_body(T, SA, n, k, fs, local_buffer);
+
+    TRACE_PROBE2(libsais64, recursion_exit, n, result);
+
+    return result;
+}
+
 static sa_sint_t libsais64_main_32s_entry(sa_sint_t * RESTRICT T, sa_sint_t * RESTRICT SA, sa_sint_t n, sa_sint_t k, sa_sint_t fs)
 {
     sa_sint_t local_buffer[LIBSAIS_LOCAL_BUFFER_SIZE];
@@ -2342,7 +2368,7 @@ static sa_sint_t libsais64_main_32s_entry(sa_sint_t * RESTRICT T, sa_sint_t * RE
     return libsais64_main_32s_recursion(T, SA, n, k, fs, local_buffer);
 }
 
-static sa_sint_t libsais64_main_8u(const uint8_t * T, sa_sint_t * SA, sa_sint_t n, sa_sint_t * RESTRICT buckets, sa_sint_t bwt, sa_sint_t r, sa_sint_t * RESTRICT I, sa_sint_t fs, sa_sint_t * freq)
+static sa_sint_t libsais64_main_8u(const uint8_t * T, sa_sint_t * SA, sa_sint_t n, sa_bucket_t * RESTRICT buckets, sa_sint_t bwt, sa_sint_t r, sa_sint_t * RESTRICT I, sa_sint_t fs, sa_sint_t * freq)
 {
     fs = fs < (SAINT_MAX - n) ? fs : (SAINT_MAX - n);
 
@@ -2381,9 +2407,13 @@ static sa_sint_t libsais64_main_8u(const uint8_t * T, sa_sint_t * SA, sa_sint_t
     return libsais64_induce_final_order_8u_omp(T, SA, n, k, bwt, r, I, buckets);
 }
 
+#if defined(LIBSAIS_BUCKET32)
+sa_sint_t libsais64_main_bucket32(const uint8_t * T, sa_sint_t * SA, sa_sint_t n, sa_sint_t bwt, sa_sint_t r, sa_sint_t * I, sa_sint_t fs, sa_sint_t * freq)
+#else
 static sa_sint_t libsais64_main(const uint8_t * T, sa_sint_t * SA, sa_sint_t n, sa_sint_t bwt, sa_sint_t r, sa_sint_t * I, sa_sint_t fs, sa_sint_t * freq)
+#endif
 {
-    sa_sint_t *             RESTRICT buckets        = (sa_sint_t *)libsais64_alloc_aligned((size_t)8 * ALPHABET_SIZE * sizeof(sa_sint_t), 4096);
+    sa_bucket_t *           RESTRICT buckets        = (sa_bucket_t *)libsais64_alloc_aligned((size_t)8 * ALPHABET_SIZE * sizeof(sa_bucket_t), 4096);
 
     sa_sint_t index = buckets != NULL
         ? libsais64_main_8u(T, SA, n, buckets, bwt, r, I, fs, freq)
@@ -2394,6 +2424,12 @@ static sa_sint_t libsais64_main(const uint8_t * T, sa_sint_t * SA, sa_sint_t n,
     return index;
 }
 
+#if !defined(LIBSAIS_BUCKET32)
+
+#if defined(LIBSAIS_DISPATCH_BUCKET32)
+sa_sint_t libsais64_main_bucket32(const uint8_t * T, sa_sint_t * SA, sa_sint_t n, sa_sint_t bwt, sa_sint_t r, sa_sint_t * I, sa_sint_t fs, sa_sint_t * freq);
+#endif
+
 int64_t libsais64(const uint8_t * T, int64_t * SA, int64_t n, int64_t fs, int64_t * freq)
 {
     if ((T == NULL) || (SA == NULL) || (n < 0) || (fs < 0))
@@ -2407,5 +2443,14 @@ int64_t libsais64(const uint8_t * T, int64_t * SA, int64_t n, int64_t fs, int64_
         return 0;
     }
 
+#if defined(LIBSAIS_DISPATCH_BUCKET32)
+    if (n <= INT32_MAX)
+    {
+        return libsais64_main_bucket32(T, SA, n, 0, 0, NULL, fs, freq);
+    }
+#endif
+
     return libsais64_main(T, SA, n, 0, 0, NULL, fs, freq);
 }
+
+#endif
@@ -0,0 +1,355 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "arrow_ipc.h"
+
+// Buffers are aligned to 64 bytes, as recommended by the Arrow format, so readers can map them directly
+#define ARROW_ALIGNMENT 64
+#define ARROW_FILL_CHUNK (1 << 16)
+
+#define ARROW_METADATA_V5 4
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_INT 2
+
+#define FB_MAX_FIELDS 8
+
+// A minimal flatbuffer builder that writes front to back: every table is preceded by its vtable and
+// followed by the objects it refers to, so all offsets are positive.
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    int failed;
+} fb_builder_t;
+
+typedef struct {
+    size_t pos;
+    size_t field_pos[FB_MAX_FIELDS];
+} fb_table_t;
+
+typedef struct {
+    int64_t offset;
+    int32_t metadata_length;
+    int64_t body_length;
+} arrow_block_t;
+
+static size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Function to append `length` zero bytes at a position p with (p + align_offset) a multiple of `alignment`
+static size_t fb_alloc(fb_builder_t* fb, size_t length, size_t alignment, size_t align_offset) {
+    size_t pos = align_up(fb->size + align_offset, alignment) - align_offset;
+    size_t size = pos + length;
+    if (size > fb->capacity) {
+        size_t capacity = fb->capacity == 0 ? 1024 : fb->capacity;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        uint8_t* data = realloc(fb->data, capacity);
+        if (data == NULL) {
+            fb->failed = 1;
+            fb->size = 0;
+            return 0;
+        }
+        fb->data = data;
+        fb->capacity = capacity;
+    }
+    memset(fb->data + fb->size, 0, size - fb->size);
+    fb->size = size;
+    return pos;
+}
+
+static void fb_put(fb_builder_t* fb, size_t pos, uint64_t value, size_t size) {
+    if (fb->failed) {
+        return;
+    }
+    for (size_t i = 0; i < size; i++) {
+        fb->data[pos + i] = (uint8_t) (value >> (8 * i));
+    }
+}
+
+static void fb_set_offset(fb_builder_t* fb, size_t field_pos, size_t target_pos) {
+    fb_put(fb, field_pos, (uint32_t) (target_pos - field_pos), sizeof(uint32_t));
+}
+
+// Function to add a table with the given field sizes (0 for absent fields), placing the largest fields first
+static fb_table_t fb_table(fb_builder_t* fb, const uint8_t* field_sizes, int n_fields) {
+    fb_table_t table;
+    size_t field_offsets[FB_MAX_FIELDS] = {0};
+    size_t inline_size = sizeof(int32_t);
+    const uint8_t sizes[4] = { 8, 4, 2, 1 };
+    for (int s = 0; s < 4; s++) {
+        for (int f = 0; f < n_fields; f++) {
+            if (field_sizes[f] == sizes[s]) {
+                inline_size = align_up(inline_size, sizes[s]);
+                field_offsets[f] = inline_size;
+                inline_size += sizes[s];
+            }
+        }
+    }
+    inline_size = align_up(inline_size, sizeof(int32_t));
+
+    size_t vtable_pos = fb_alloc(fb, 2 * sizeof(uint16_t) + n_fields * sizeof(uint16_t), sizeof(uint16_t), 0);
+    fb_put(fb, vtable_pos, 2 * sizeof(uint16_t) + n_fields * sizeof(uint16_t), sizeof(uint16_t));
+    fb_put(fb, vtable_pos + 2, inline_size, sizeof(uint16_t));
+    for (int f = 0; f < n_fields; f++) {
+        fb_put(fb, vtable_pos + 4 + 2 * f, field_offsets[f], sizeof(uint16_t));
+    }
+
+    table.pos = fb_alloc(fb, inline_size, 8, 0);
+    fb_put(fb, table.pos, (uint32_t) (int32_t) (table.pos - vtable_pos), sizeof(int32_t));
+    for (int f = 0; f < n_fields; f++) {
+        table.field_pos[f] = table.pos + field_offsets[f];
+    }
+    return table;
+}
+
+static size_t fb_string(fb_builder_t* fb, const char* s) {
+    size_t length = strlen(s);
+    size_t pos = fb_alloc(fb, sizeof(uint32_t) + length + 1, sizeof(uint32_t), 0);
+    fb_put(fb, pos, length, sizeof(uint32_t));
+    if (!fb->failed) {
+        memcpy(fb->data + pos + sizeof(uint32_t), s, length);
+    }
+    return pos;
+}
+
+// Function to add a vector of offsets, elements are set afterwards with fb_set_offset
+static size_t fb_offset_vector(fb_builder_t* fb, size_t n) {
+    size_t pos = fb_alloc(fb, sizeof(uint32_t) + n * sizeof(uint32_t), sizeof(uint32_t), 0);
+    fb_put(fb, pos, n, sizeof(uint32_t));
+    return pos;
+}
+
+// Function to add a vector of 8-byte aligned structs, elements are written afterwards with fb_put
+static size_t fb_struct_vector(fb_builder_t* fb, size_t n, size_t struct_size) {
+    size_t pos = fb_alloc(fb, sizeof(uint32_t) + n * struct_size, 8, sizeof(uint32_t));
+    fb_put(fb, pos, n, sizeof(uint32_t));
+    return pos;
+}
+
+static size_t fb_vector_element(size_t vector_pos, size_t i, size_t element_size) {
+    return vector_pos + sizeof(uint32_t) + i * element_size;
+}
+
+static size_t fb_schema(fb_builder_t* fb, const arrow_column_t* columns, size_t n_columns, const arrow_metadata_t* metadata, size_t n_metadata) {
+    // Schema: endianness, fields, custom_metadata
+    uint16_t probe = 1;
+    int big_endian = *(uint8_t*) &probe == 0;
+    const uint8_t schema_fields[3] = { 2, 4, n_metadata > 0 ? 4 : 0 };
+    fb_table_t schema = fb_table(fb, schema_fields, 3);
+    fb_put(fb, schema.field_pos[0], big_endian, sizeof(int16_t));
+
+    size_t fields = fb_offset_vector(fb, n_columns);
+    fb_set_offset(fb, schema.field_pos[1], fields);
+    for (size_t c = 0; c < n_columns; c++) {
+        // Field: name, nullable, type_type, type, dictionary, children
+        const uint8_t field_fields[6] = { 4, 1, 1, 4, 0, 4 };
+        fb_table_t field = fb_table(fb, field_fields, 6);
+        fb_set_offset(fb, fb_vector_element(fields, c, sizeof(uint32_t)), field.pos);
+        fb_put(fb, field.field_pos[2], ARROW_TYPE_INT, sizeof(uint8_t));
+        fb_set_offset(fb, field.field_pos[0], fb_string(fb, columns[c].name));
+
+        // Int: bitWidth, is_signed
+        const uint8_t int_fields[2] = { 4, 1 };
+        fb_table_t type = fb_table(fb, int_fields, 2);
+        fb_put(fb, type.field_pos[0], columns[c].bit_width, sizeof(int32_t));
+        fb_put(fb, type.field_pos[1], columns[c].is_signed, sizeof(uint8_t));
+        fb_set_offset(fb, field.field_pos[3], type.pos);
+
+        fb_set_offset(fb, field.field_pos[5], fb_offset_vector(fb, 0));
+    }
+
+    if (n_metadata > 0) {
+        size_t pairs = fb_offset_vector(fb, n_metadata);
+        fb_set_offset(fb, schema.field_pos[2], pairs);
+        for (size_t m = 0; m < n_metadata; m++) {
+            // KeyValue: key, value
+            const uint8_t pair_fields[2] = { 4, 4 };
+            fb_table_t pair = fb_table(fb, pair_fields, 2);
+            fb_set_offset(fb, fb_vector_element(pairs, m, sizeof(uint32_t)), pair.pos);
+            fb_set_offset(fb, pair.field_pos[0], fb_string(fb, metadata[m].key));
+            fb_set_offset(fb, pair.field_pos[1], fb_string(fb, metadata[m].value));
+        }
+    }
+
+    return schema.pos;
+}
+
+// Function to start a Message flatbuffer and return the position of its header offset
+static size_t fb_message(fb_builder_t* fb, uint8_t header_type, int64_t body_length) {
+    size_t root = fb_alloc(fb, sizeof(uint32_t), sizeof(uint32_t), 0);
+
+    // Message: version, header_type, header, bodyLength
+    const uint8_t message_fields[4] = { 2, 1, 4, 8 };
+    fb_table_t message = fb_table(fb, message_fields, 4);
+    fb_set_offset(fb, root, message.pos);
+    fb_put(fb, message.field_pos[0], ARROW_METADATA_V5, sizeof(int16_t));
+    fb_put(fb, message.field_pos[1], header_type, sizeof(uint8_t));
+    fb_put(fb, message.field_pos[3], (uint64_t) body_length, sizeof(int64_t));
+    return message.field_pos[2];
+}
+
+static int write_zeros(FILE* file, size_t n) {
+    static const uint8_t zeros[ARROW_ALIGNMENT] = {0};
+    while (n > 0) {
+        size_t chunk = n < ARROW_ALIGNMENT ? n : ARROW_ALIGNMENT;
+        if (fwrite(zeros, 1, chunk, file) != chunk) {
+            return -1;
+        }
+        n -= chunk;
+    }
+    return 0;
+}
+
+// Function to write an encapsulated message: a continuation marker, the metadata length and the metadata,
+// padded so the message body that follows starts on an aligned file offset
+static int write_message(FILE* file, size_t* file_pos, const fb_builder_t* fb, int64_t body_length, arrow_block_t* block) {
+    size_t metadata_length = align_up(*file_pos + 2 * sizeof(int32_t) + fb->size, ARROW_ALIGNMENT) - *file_pos - 2 * sizeof(int32_t);
+    uint32_t prefix[2] = { 0xFFFFFFFF, (uint32_t) metadata_length };
+
+    if (fwrite(prefix, sizeof(uint32_t), 2, file) != 2
+            || fwrite(fb->data, 1, fb->size, file) != fb->size
+            || write_zeros(file, metadata_length - fb->size) != 0) {
+        return -1;
+    }
+
+    if (block != NULL) {
+        block->offset = (int64_t) *file_pos;
+        block->metadata_length = (int32_t) (metadata_length + 2 * sizeof(int32_t));
+        block->body_length = body_length;
+    }
+    *file_pos += 2 * sizeof(int32_t) + metadata_length;
+    return 0;
+}
+
+// Function to write integer columns as an Arrow IPC file with a single record batch. The values of every
+// column are filled in chunks, so no copy of a full column is ever held in memory. Returns -1 on failure.
+int write_arrow_ipc(const char* output_fn, const arrow_column_t* columns, size_t n_columns, size_t length, const arrow_metadata_t* metadata, size_t n_metadata) {
+    FILE* file = fopen(output_fn, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    fb_builder_t fb = { NULL, 0, 0, 0 };
+    size_t file_pos = 0;
+    int result = -1;
+    uint8_t* chunk = NULL;
+
+    // File magic, padded to 8 bytes
+    const char magic[8] = { 'A', 'R', 'R', 'O', 'W', '1', 0, 0 };
+    if (fwrite(magic, 1, sizeof(magic), file) != sizeof(magic)) {
+        goto cleanup;
+    }
+    file_pos += sizeof(magic);
+
+    fb_set_offset(&fb, fb_message(&fb, ARROW_HEADER_SCHEMA, 0), fb_schema(&fb, columns, n_columns, metadata, n_metadata));
+    if (fb.failed || write_message(file, &file_pos, &fb, 0, NULL) != 0) {
+        goto cleanup;
+    }
+
+    // Lay out the body: an empty validity buffer and a data buffer per column
+    int64_t body_length = 0;
+    int64_t* data_offsets = malloc((n_columns + 1) * sizeof(int64_t));
+    if (data_offsets == NULL) {
+        goto cleanup;
+    }
+    for (size_t c = 0; c < n_columns; c++) {
+        data_offsets[c] = body_length;
+        body_length += (int64_t) align_up(length * (columns[c].bit_width / 8), ARROW_ALIGNMENT);
+    }
+    data_offsets[n_columns] = body_length;
+
+    fb.size = 0;
+    size_t header = fb_message(&fb, ARROW_HEADER_RECORD_BATCH, body_length);
+
+    // RecordBatch: length, nodes, buffers
+    const uint8_t batch_fields[3] = { 8, 4, 4 };
+    fb_table_t batch = fb_table(&fb, batch_fields, 3);
+    fb_set_offset(&fb, header, batch.pos);
+    fb_put(&fb, batch.field_pos[0], length, sizeof(int64_t));
+
+    size_t nodes = fb_struct_vector(&fb, n_columns, 2 * sizeof(int64_t));
+    fb_set_offset(&fb, batch.field_pos[1], nodes);
+    size_t buffers = fb_struct_vector(&fb, 2 * n_columns, 2 * sizeof(int64_t));
+    fb_set_offset(&fb, batch.field_pos[2], buffers);
+    for (size_t c = 0; c < n_columns; c++) {
+        size_t node = fb_vector_element(nodes, c, 2 * sizeof(int64_t));
+        fb_put(&fb, node, length, sizeof(int64_t));
+        size_t validity = fb_vector_element(buffers, 2 * c, 2 * sizeof(int64_t));
+        fb_put(&fb, validity, (uint64_t) data_offsets[c], sizeof(int64_t));
+        size_t values = fb_vector_element(buffers, 2 * c + 1, 2 * sizeof(int64_t));
+        fb_put(&fb, values, (uint64_t) data_offsets[c], sizeof(int64_t));
+        fb_put(&fb, values + sizeof(int64_t), length * (columns[c].bit_width / 8), sizeof(int64_t));
+    }
+    free(data_offsets);
+
+    arrow_block_t block;
+    if (fb.failed || write_message(file, &file_pos, &fb, body_length, &block) != 0) {
+        goto cleanup;
+    }
+
+    chunk = malloc(ARROW_FILL_CHUNK * sizeof(uint64_t));
+    if (chunk == NULL) {
+        goto cleanup;
+    }
+    for (size_t c = 0; c < n_columns; c++) {
+        size_t value_size = columns[c].bit_width / 8;
+        for (size_t start = 0; start < length; start += ARROW_FILL_CHUNK) {
+            size_t count = length - start < ARROW_FILL_CHUNK ? length - start : ARROW_FILL_CHUNK;
+            columns[c].fill(chunk, start, count, columns[c].data);
+            if (fwrite(chunk, value_size, count, file) != count) {
+                goto cleanup;
+            }
+        }
+        size_t data_length = length * value_size;
+        if (write_zeros(file, align_up(data_length, ARROW_ALIGNMENT) - data_length) != 0) {
+            goto cleanup;
+        }
+    }
+    file_pos += (size_t) body_length;
+
+    // End-of-stream marker
+    const uint32_t eos[2] = { 0xFFFFFFFF, 0 };
+    if (fwrite(eos, sizeof(uint32_t), 2, file) != 2) {
+        goto cleanup;
+    }
+
+    // Footer: version, schema, dictionaries, recordBatches
+    fb.size = 0;
+    size_t root = fb_alloc(&fb, sizeof(uint32_t), sizeof(uint32_t), 0);
+    const uint8_t footer_fields[4] = { 2, 4, 0, 4 };
+    fb_table_t footer = fb_table(&fb, footer_fields, 4);
+    fb_set_offset(&fb, root, footer.pos);
+    fb_put(&fb, footer.field_pos[0], ARROW_METADATA_V5, sizeof(int16_t));
+    fb_set_offset(&fb, footer.field_pos[1], fb_schema(&fb, columns, n_columns, metadata, n_metadata));
+
+    // Block: offset, metaDataLength (padded to 8 bytes), bodyLength
+    size_t blocks = fb_struct_vector(&fb, 1, 3 * sizeof(int64_t));
+    fb_set_offset(&fb, footer.field_pos[3], blocks);
+    size_t element = fb_vector_element(blocks, 0, 3 * sizeof(int64_t));
+    fb_put(&fb, element, (uint64_t) block.offset, sizeof(int64_t));
+    fb_put(&fb, element + sizeof(int64_t), (uint32_t) block.metadata_length, sizeof(int32_t));
+    fb_put(&fb, element + 2 * sizeof(int64_t), (uint64_t) block.body_length, sizeof(int64_t));
+
+    int32_t footer_length = (int32_t) fb.size;
+    if (fb.failed
+            || fwrite(fb.data, 1, fb.size, file) != fb.size
+            || fwrite(&footer_length, sizeof(int32_t), 1, file) != 1
+            || fwrite(magic, 1, 6, file) != 6) {
+        goto cleanup;
+    }
+    result = 0;
+
+cleanup:
+    free(chunk);
+    free(fb.data);
+    if (fclose(file) != 0) {
+        result = -1;
+    }
+    return result;
+}
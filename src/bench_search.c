@@ -0,0 +1,1046 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "join.h"
+#include "libsais64.h"
+#include "locate.h"
+#include "motif.h"
+#include "records.h"
+#include "repeats.h"
+#include "search.h"
+#include "ssa_index.h"
+#include "ssa_reader.h"
+#include "ssd_index.h"
+#include "text_store.h"
+#include "windows.h"
+
+#define ZIPF_EXPONENT 1.0
+#define ABSENT_ATTEMPTS 32
+// Batch size of the SSD query mode, and the blocks of cache per query of a batch, so the queries of a
+// batch do not evict the blocks the others read again. Both runs get the same cache of 8 MB.
+#define SSD_BATCH_SIZE 64
+#define SSD_CACHE_BLOCKS_PER_QUERY 32
+#define SSD_CACHE_BLOCKS (SSD_BATCH_SIZE * SSD_CACHE_BLOCKS_PER_QUERY)
+// Second index of the join benchmark, a full index of random substrings of the benchmarked text
+#define JOIN_SAMPLE_PIECES 64
+#define JOIN_SAMPLE_PIECE_LENGTH 256
+#define REPEATS_TOP 10
+
+typedef struct {
+    uint8_t* pattern;
+    size_t length;
+} query_t;
+
+typedef struct {
+    const char* name;
+    query_t* queries;
+    size_t n_queries;
+} workload_t;
+
+typedef struct {
+    int misses_fd;
+    int references_fd;
+} cache_counters_t;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+void print_usage() {
+    printf("Usage: ./bench_search [-n <queries>] [-r <seed>] [-l <min_length>] [-L <max_length>] [-t <threads>] <text_file> <sa_file>\n\n");
+    printf("-n <queries>        : Number of queries per workload (default 10000).\n");
+    printf("-r <seed>           : Seed of the workload generator (default 1).\n");
+    printf("-l <min_length>     : Minimum length of a query (default 5).\n");
+    printf("-L <max_length>     : Maximum length of a query (default 30).\n");
+    printf("-t <threads>        : Number of threads of the locate benchmark (default 4).\n");
+    printf("<text_file>         : The text the suffix array was built on.\n");
+    printf("<sa_file>           : The suffix array written by build_ssa.\n");
+}
+
+// Function to draw a pseudo-random number with xorshift64*, so workloads are reproducible across platforms
+static uint64_t next_random() {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static query_t copy_query(const uint8_t* pattern, size_t length) {
+    query_t query = { malloc(length), length };
+    if (query.pattern == NULL) {
+        perror("Failed to allocate memory for a query");
+        exit(1);
+    }
+    memcpy(query.pattern, pattern, length);
+    return query;
+}
+
+static void free_workload(workload_t* workload) {
+    for (size_t i = 0; i < workload->n_queries; i++) {
+        free(workload->queries[i].pattern);
+    }
+    free(workload->queries);
+}
+
+// Function to collect all peptides of an in-silico tryptic digest: cleave after K or R, unless followed by P
+static query_t* tryptic_digest(const ssa_index_t* index, size_t min_length, size_t max_length, size_t* n_peptides) {
+    size_t capacity = 1024;
+    query_t* peptides = malloc(capacity * sizeof(query_t));
+    *n_peptides = 0;
+
+    size_t start = 0;
+    for (size_t i = 0; i < index->text_len; i++) {
+        uint8_t c = index->text[i];
+        int separator = ssa_is_separator(c);
+        int cleave = separator || ((c == 'K' || c == 'R') && (i + 1 == index->text_len || index->text[i + 1] != 'P'));
+        if (!cleave && i + 1 < index->text_len) {
+            continue;
+        }
+
+        size_t end = separator ? i : i + 1;
+        size_t length = end - start;
+        if (length >= min_length && length <= max_length) {
+            if (*n_peptides == capacity) {
+                capacity *= 2;
+                peptides = realloc(peptides, capacity * sizeof(query_t));
+            }
+            peptides[(*n_peptides)++] = (query_t) { (uint8_t*) index->text + start, length };
+        }
+        start = i + 1;
+    }
+
+    return peptides;
+}
+
+// Function to pick a random substring of a single record, or return 0 after too many misses
+static int random_substring(const ssa_index_t* index, size_t min_length, size_t max_length, query_t* query) {
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        size_t length = min_length + next_random() % (max_length - min_length + 1);
+        if (length > index->text_len) {
+            return 0;
+        }
+        size_t position = next_random() % (index->text_len - length + 1);
+        if (ssa_separator_free_length(index->text + position, length) == length) {
+            *query = (query_t) { (uint8_t*) index->text + position, length };
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static workload_t sample_uniform(const char* name, const query_t* pool, size_t pool_size, size_t n_queries) {
+    workload_t workload = { name, malloc(n_queries * sizeof(query_t)), 0 };
+    for (size_t i = 0; i < n_queries && pool_size > 0; i++) {
+        const query_t* query = &pool[next_random() % pool_size];
+        workload.queries[workload.n_queries++] = copy_query(query->pattern, query->length);
+    }
+    return workload;
+}
+
+// Function to sample queries from a pool with a Zipf distribution on popularity, as seen in production logs
+static workload_t sample_skewed(const char* name, const query_t* pool, size_t pool_size, size_t n_queries) {
+    workload_t workload = { name, malloc(n_queries * sizeof(query_t)), 0 };
+    if (pool_size == 0) {
+        return workload;
+    }
+
+    double* cdf = malloc(pool_size * sizeof(double));
+    double total = 0;
+    for (size_t r = 0; r < pool_size; r++) {
+        total += 1.0 / pow((double) (r + 1), ZIPF_EXPONENT);
+        cdf[r] = total;
+    }
+
+    // Popularity ranks are scattered over the pool, so popular queries are not neighbours in the text
+    size_t offset = next_random() % pool_size;
+    for (size_t i = 0; i < n_queries; i++) {
+        double u = (next_random() >> 11) * (1.0 / 9007199254740992.0) * total;
+        size_t lo = 0, hi = pool_size - 1;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (cdf[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        const query_t* query = &pool[(lo * 2654435761ULL + offset) % pool_size];
+        workload.queries[workload.n_queries++] = copy_query(query->pattern, query->length);
+    }
+
+    free(cdf);
+    return workload;
+}
+
+// Function to generate peptides that do not occur, by mutating random substrings until they have no hits
+static workload_t sample_absent(const char* name, const ssa_index_t* index, size_t min_length, size_t max_length, size_t n_queries) {
+    workload_t workload = { name, malloc(n_queries * sizeof(query_t)), 0 };
+
+    uint8_t residues[256];
+    size_t n_residues = 0;
+    for (size_t r = 0; r < index->alphabet_size; r++) {
+        if (!ssa_is_separator(index->rank_to_char[r])) {
+            residues[n_residues++] = index->rank_to_char[r];
+        }
+    }
+
+    query_t source;
+    while (workload.n_queries < n_queries && n_residues > 1 && random_substring(index, min_length, max_length, &source)) {
+        query_t query = copy_query(source.pattern, source.length);
+        int absent = 0;
+        for (int attempt = 0; attempt < ABSENT_ATTEMPTS && !absent; attempt++) {
+            query.pattern[next_random() % query.length] = residues[next_random() % n_residues];
+            absent = ssa_search(index, query.pattern, query.length, SEARCH_LCP, NULL, NULL) == 0;
+        }
+        if (!absent) {
+            free(query.pattern);
+            break;
+        }
+        workload.queries[workload.n_queries++] = query;
+    }
+    return workload;
+}
+
+static int open_counter(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t read_counter(int fd) {
+    uint64_t value = 0;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+    return value;
+}
+
+static void set_counters(const cache_counters_t* counters, int enable) {
+    int fds[2] = { counters->misses_fd, counters->references_fd };
+    for (int i = 0; i < 2; i++) {
+        if (fds[i] >= 0) {
+            ioctl(fds[i], enable ? PERF_EVENT_IOC_RESET : PERF_EVENT_IOC_DISABLE, 0);
+            if (enable) {
+                ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+// Function to run one workload and print its throughput, latency percentiles and cache behaviour
+static void run_workload(const char* layout, const ssa_index_t* index, search_strategy_t strategy, const workload_t* workload, const cache_counters_t* counters) {
+    if (workload->n_queries == 0) {
+        return;
+    }
+
+    double* latencies = malloc(workload->n_queries * sizeof(double));
+    size_t hits = 0;
+
+    struct rusage usage_before, usage_after;
+    getrusage(RUSAGE_SELF, &usage_before);
+    set_counters(counters, 1);
+    double start = now_seconds();
+
+    for (size_t i = 0; i < workload->n_queries; i++) {
+        double query_start = now_seconds();
+        hits += ssa_search(index, workload->queries[i].pattern, workload->queries[i].length, strategy, NULL, NULL);
+        latencies[i] = now_seconds() - query_start;
+    }
+
+    double elapsed = now_seconds() - start;
+    set_counters(counters, 0);
+    getrusage(RUSAGE_SELF, &usage_after);
+
+    qsort(latencies, workload->n_queries, sizeof(double), compare_double);
+    double p50 = latencies[(workload->n_queries - 1) / 2];
+    double p99 = latencies[(size_t) ((workload->n_queries - 1) * 0.99)];
+
+    char cache[64] = "n/a";
+    if (counters->misses_fd >= 0 && counters->references_fd >= 0) {
+        uint64_t misses = read_counter(counters->misses_fd);
+        uint64_t references = read_counter(counters->references_fd);
+        snprintf(cache, sizeof(cache), "%.1f (%.1f%%)", (double) misses / workload->n_queries, references > 0 ? 100.0 * misses / references : 0.0);
+    }
+    long faults = (usage_after.ru_minflt - usage_before.ru_minflt) + (usage_after.ru_majflt - usage_before.ru_majflt);
+
+    printf("%-10s %-8s %-10s %10.0f %10.2f %10.2f %12.2f %16s %8ld\n", layout, strategy == SEARCH_LCP ? "lcp" : "binary",
+        workload->name, workload->n_queries / elapsed, p50 * 1e6, p99 * 1e6, (double) hits / workload->n_queries, cache, faults);
+    free(latencies);
+}
+
+typedef struct {
+    int64_t* positions;
+    size_t n_positions;
+    size_t capacity;
+} hit_list_t;
+
+static void collect_hit(int64_t position, void* data) {
+    hit_list_t* hits = data;
+    if (hits->n_positions == hits->capacity) {
+        hits->capacity = hits->capacity == 0 ? 1024 : 2 * hits->capacity;
+        hits->positions = realloc(hits->positions, hits->capacity * sizeof(int64_t));
+    }
+    hits->positions[hits->n_positions++] = position;
+}
+
+static int compare_position(const void* a, const void* b) {
+    int64_t x = *(const int64_t*) a;
+    int64_t y = *(const int64_t*) b;
+    return (x > y) - (x < y);
+}
+
+// Function to compare collecting and sorting the hits of a workload afterwards with ssa_locate, which
+// sorts them and groups them by record
+static void run_locate(const ssa_index_t* index, const record_table_t* records, const workload_t* workload, int n_threads) {
+    if (workload->n_queries == 0) {
+        return;
+    }
+
+    hit_list_t hits = { NULL, 0, 0 };
+    size_t n_hits = 0;
+    double start = now_seconds();
+    for (size_t i = 0; i < workload->n_queries; i++) {
+        hits.n_positions = 0;
+        ssa_search(index, workload->queries[i].pattern, workload->queries[i].length, SEARCH_LCP, collect_hit, &hits);
+        qsort(hits.positions, hits.n_positions, sizeof(int64_t), compare_position);
+        n_hits += hits.n_positions;
+    }
+    double sort_elapsed = now_seconds() - start;
+    free(hits.positions);
+
+    size_t n_groups = 0;
+    start = now_seconds();
+    for (size_t i = 0; i < workload->n_queries; i++) {
+        locate_result_t result;
+        if (ssa_locate(index, workload->queries[i].pattern, workload->queries[i].length, SEARCH_LCP, records, n_threads, &result) != 0) {
+            perror("Failed to locate");
+            return;
+        }
+        n_groups += result.n_groups;
+        locate_result_free(&result);
+    }
+    double locate_elapsed = now_seconds() - start;
+
+    printf("%-10s %10zu %10zu %16.0f %16.0f\n", workload->name, n_hits, n_groups,
+        workload->n_queries / sort_elapsed, workload->n_queries / locate_elapsed);
+}
+
+typedef struct {
+    const text_store_t* store;
+    const query_t* query;
+    size_t matches;
+} verify_data_t;
+
+static void verify_hit(int64_t position, void* data) {
+    verify_data_t* verify = data;
+    verify->matches += text_store_compare(verify->store, (size_t) position, verify->query->pattern, verify->query->length, NULL) == 0;
+}
+
+// Function to write a text store to a temporary file and load it back. Returns -1 if either fails.
+static int reload_text_store(text_store_t* store, size_t* file_size) {
+    char path[] = "/tmp/bench_text_store_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return -1;
+    }
+    close(fd);
+
+    text_store_t loaded;
+    int failed = text_store_write(store, path) != 0 || text_store_load(&loaded, path) != 0;
+    struct stat st;
+    *file_size = stat(path, &st) == 0 ? (size_t) st.st_size : 0;
+    unlink(path);
+    if (failed) {
+        return -1;
+    }
+    text_store_free(store);
+    *store = loaded;
+    return 0;
+}
+
+// Function to compare the size of the entropy-coded text store with the bitpacked text, and measure how
+// fast it extracts substrings and verifies the hits of a workload. The store is written to a file and
+// loaded back first, and the whole text extracted from the loaded store must match the indexed one.
+static void run_text_store(const ssa_index_t* index, const workload_t* workload) {
+    text_store_t store;
+    if (text_store_build(&store, index->text, index->text_len) != 0) {
+        perror("Failed to build text store");
+        return;
+    }
+    size_t file_size;
+    if (reload_text_store(&store, &file_size) != 0) {
+        perror("Failed to write and load text store");
+        text_store_free(&store);
+        return;
+    }
+
+    size_t bits_per_char = 0;
+    while (((size_t) 1 << bits_per_char) < index->alphabet_size) {
+        bits_per_char++;
+    }
+    printf("\ntext store: %zu bytes, %.2f bits/char (bitpacked: %zu bits/char, plain: 8 bits/char)\n",
+        text_store_size(&store), 8.0 * text_store_size(&store) / index->text_len, bits_per_char);
+
+    uint8_t buffer[64];
+    int match = 1;
+    for (size_t p = 0; p < index->text_len && match; p += sizeof(buffer)) {
+        size_t n = text_store_extract(&store, p, sizeof(buffer), buffer);
+        match = n == (index->text_len - p < sizeof(buffer) ? index->text_len - p : sizeof(buffer)) && memcmp(buffer, index->text + p, n) == 0;
+    }
+    printf("written and loaded: %zu bytes on disk, text matches: %s\n", file_size, match ? "yes" : "NO");
+
+    size_t n_extracts = workload->n_queries * 10;
+    double start = now_seconds();
+    for (size_t i = 0; i < n_extracts; i++) {
+        text_store_extract(&store, next_random() % index->text_len, sizeof(buffer), buffer);
+    }
+    double elapsed = now_seconds() - start;
+    printf("extract(pos, %zu): %.0f per second\n", sizeof(buffer), n_extracts / elapsed);
+
+    verify_data_t verify = { &store, NULL, 0 };
+    size_t hits = 0;
+    start = now_seconds();
+    for (size_t i = 0; i < workload->n_queries; i++) {
+        verify.query = &workload->queries[i];
+        hits += ssa_search(index, verify.query->pattern, verify.query->length, SEARCH_LCP, verify_hit, &verify);
+    }
+    elapsed = now_seconds() - start;
+    printf("%s hits verified against the store: %zu of %zu, %.0f queries/s\n", workload->name, verify.matches, hits, workload->n_queries / elapsed);
+
+    text_store_free(&store);
+}
+
+// Function to compare searching every window of `window_len` characters of random records on its own
+// with ssa_search_windows, until at least `n_windows` windows are searched
+static void run_windows(const ssa_index_t* index, const bucket_table_t* buckets, const record_table_t* records, size_t window_len, size_t n_windows) {
+    size_t searched = 0;
+    size_t window_hits = 0, stream_hits = 0;
+    double window_elapsed = 0, stream_elapsed = 0;
+    for (int attempt = 0; searched < n_windows && attempt < 1000000; attempt++) {
+        size_t record = next_random() % records->n_records;
+        const uint8_t* sequence = index->text + records->offsets[record];
+        size_t sequence_len = (size_t) (records->offsets[record + 1] - records->offsets[record]) - 1;
+        if (sequence_len < window_len) {
+            continue;
+        }
+
+        double start = now_seconds();
+        for (size_t i = 0; i + window_len <= sequence_len; i++) {
+            window_hits += ssa_search(index, sequence + i, window_len, SEARCH_LCP, NULL, NULL);
+        }
+        window_elapsed += now_seconds() - start;
+
+        start = now_seconds();
+        stream_hits += ssa_search_windows(index, buckets, sequence, sequence_len, window_len, NULL, NULL);
+        stream_elapsed += now_seconds() - start;
+        searched += sequence_len - window_len + 1;
+    }
+
+    printf("%-10zu %10zu %12zu %12zu %16.0f %16.0f\n", window_len, searched, window_hits, stream_hits,
+        searched / window_elapsed, searched / stream_elapsed);
+}
+
+// A match of a motif: motifs with repeats can match several lengths at one position
+typedef struct {
+    int64_t position;
+    size_t length;
+} motif_hit_t;
+
+typedef struct {
+    motif_hit_t* hits;
+    size_t n_hits;
+    size_t capacity;
+} motif_hit_list_t;
+
+static void collect_motif_hit(int64_t position, size_t length, void* data) {
+    motif_hit_list_t* list = data;
+    if (list->n_hits == list->capacity) {
+        list->capacity = list->capacity == 0 ? 1024 : 2 * list->capacity;
+        list->hits = realloc(list->hits, list->capacity * sizeof(motif_hit_t));
+    }
+    list->hits[list->n_hits++] = (motif_hit_t) { position, length };
+}
+
+static int compare_motif_hit(const void* a, const void* b) {
+    const motif_hit_t* x = a;
+    const motif_hit_t* y = b;
+    if (x->position != y->position) {
+        return (x->position > y->position) - (x->position < y->position);
+    }
+    return (x->length > y->length) - (x->length < y->length);
+}
+
+// Function to check whether a character of the text is in the set of ranks of a motif element
+static int motif_element_has(const ssa_index_t* index, const motif_element_t* element, uint8_t c) {
+    uint8_t rank = index->char_to_rank[c];
+    return index->rank_to_char[rank] == c && ((element->ranks[rank >> 6] >> (rank & 63)) & 1);
+}
+
+// Function to match the elements of a motif from element e on, at position p of the text, by backtracking
+// over the repeats, and collect every length of a match that started at `start`
+static void scan_motif(const ssa_index_t* index, const motif_t* motif, size_t e, size_t p, size_t start, motif_hit_list_t* list) {
+    if (e == motif->n_elements) {
+        if (!motif->anchored_end || p == index->text_len || ssa_is_separator(index->text[p])) {
+            collect_motif_hit((int64_t) start, p - start, list);
+        }
+        return;
+    }
+
+    const motif_element_t* element = &motif->elements[e];
+    if (element->literal != NULL) {
+        if (p + element->literal_len <= index->text_len && memcmp(index->text + p, element->literal, element->literal_len) == 0) {
+            scan_motif(index, motif, e + 1, p + element->literal_len, start, list);
+        }
+        return;
+    }
+    for (uint32_t count = 0; ; count++) {
+        if (count >= element->min_repeat) {
+            scan_motif(index, motif, e + 1, p, start, list);
+        }
+        if (count == element->max_repeat || p >= index->text_len || !motif_element_has(index, element, index->text[p])) {
+            return;
+        }
+        p++;
+    }
+}
+
+// Function to search a PROSITE-style motif through the SA and compare its matches with a scan of the whole
+// text, which tries the motif at every position
+static void run_motif(const ssa_index_t* index, const char* pattern) {
+    motif_t motif;
+    if (motif_compile(pattern, index, &motif) != 0) {
+        printf("%-24s failed to compile\n", pattern);
+        return;
+    }
+
+    motif_hit_list_t found = { NULL, 0, 0 };
+    double start = now_seconds();
+    motif_search(index, &motif, collect_motif_hit, &found);
+    double search_elapsed = now_seconds() - start;
+
+    motif_hit_list_t scanned = { NULL, 0, 0 };
+    start = now_seconds();
+    for (size_t p = 0; motif.matchable && p < index->text_len; p++) {
+        if (!motif.anchored_start || p == 0 || ssa_is_separator(index->text[p - 1])) {
+            scan_motif(index, &motif, 0, p, p, &scanned);
+        }
+    }
+    double scan_elapsed = now_seconds() - start;
+
+    // Different repeats may give the same match, which the search reports once
+    qsort(found.hits, found.n_hits, sizeof(motif_hit_t), compare_motif_hit);
+    qsort(scanned.hits, scanned.n_hits, sizeof(motif_hit_t), compare_motif_hit);
+    size_t n_scanned = 0;
+    for (size_t i = 0; i < scanned.n_hits; i++) {
+        if (n_scanned == 0 || compare_motif_hit(&scanned.hits[n_scanned - 1], &scanned.hits[i]) != 0) {
+            scanned.hits[n_scanned++] = scanned.hits[i];
+        }
+    }
+    int match = found.n_hits == n_scanned
+        && (n_scanned == 0 || memcmp(found.hits, scanned.hits, n_scanned * sizeof(motif_hit_t)) == 0);
+
+    printf("%-24s %10zu %14.2f %14.2f %10s\n", pattern, found.n_hits, search_elapsed * 1e3, scan_elapsed * 1e3, match ? "yes" : "NO");
+    free(found.hits);
+    free(scanned.hits);
+    motif_free(&motif);
+}
+
+// Function to build a full index over `n_pieces` random substrings of `piece_len` characters of the text of
+// an index, one per record, as a second index that shares substrings with it. Returns -1 if memory runs out.
+static int build_sample_index(const ssa_index_t* index, size_t n_pieces, size_t piece_len, ssa_index_t* sample, uint8_t** text, int64_t** sa) {
+    if (piece_len > index->text_len) {
+        piece_len = index->text_len;
+    }
+    size_t text_len = n_pieces * (piece_len + 1);
+    *text = malloc(text_len);
+    *sa = malloc(text_len * sizeof(int64_t));
+    if (*text == NULL || *sa == NULL) {
+        free(*text);
+        free(*sa);
+        return -1;
+    }
+
+    for (size_t i = 0; i < n_pieces; i++) {
+        size_t start = next_random() % (index->text_len - piece_len + 1);
+        memcpy(*text + i * (piece_len + 1), index->text + start, piece_len);
+        (*text)[i * (piece_len + 1) + piece_len] = i + 1 < n_pieces ? '-' : '$';
+    }
+    libsais64(*text, *sa, (int64_t) text_len, 0, NULL);
+    return ssa_index_init(sample, *text, text_len, *sa, text_len, 64, 1);
+}
+
+// A match of a join, at a position in both texts
+typedef struct {
+    int64_t position_a;
+    int64_t position_b;
+    size_t length;
+} join_hit_t;
+
+typedef struct {
+    join_hit_t* hits;
+    size_t n_hits;
+    size_t capacity;
+    int swapped;
+} join_hit_list_t;
+
+static void collect_join_hit(int64_t position_a, int64_t position_b, size_t length, void* data) {
+    join_hit_list_t* list = data;
+    if (list->n_hits == list->capacity) {
+        list->capacity = list->capacity == 0 ? 1024 : 2 * list->capacity;
+        list->hits = realloc(list->hits, list->capacity * sizeof(join_hit_t));
+    }
+    list->hits[list->n_hits++] = list->swapped ? (join_hit_t) { position_b, position_a, length } : (join_hit_t) { position_a, position_b, length };
+}
+
+static int compare_join_hit(const void* a, const void* b) {
+    const join_hit_t* x = a;
+    const join_hit_t* y = b;
+    if (x->position_a != y->position_a) {
+        return (x->position_a > y->position_a) - (x->position_a < y->position_a);
+    }
+    return (x->position_b > y->position_b) - (x->position_b < y->position_b);
+}
+
+typedef struct {
+    const ssa_index_t* a;
+    const ssa_index_t* b;
+    size_t position_b;
+    join_hit_list_t* list;
+} join_reference_t;
+
+// Function to keep an occurrence in the first index of a substring of the second one if the match does not
+// extend to the left, with the length of the whole match
+static void collect_reference_hit(int64_t position, void* data) {
+    join_reference_t* reference = data;
+    const ssa_index_t* a = reference->a;
+    const ssa_index_t* b = reference->b;
+    size_t pa = (size_t) position;
+    size_t pb = reference->position_b;
+    if (pa > 0 && pb > 0 && a->text[pa - 1] == b->text[pb - 1] && !ssa_is_separator(a->text[pa - 1])) {
+        return;
+    }
+    size_t length = packed_lcp(a->text + pa, a->text_len - pa, b->text + pb, b->text_len - pb);
+    collect_join_hit(position, (int64_t) pb, ssa_separator_free_length(a->text + pa, length), reference->list);
+}
+
+// Function to join an index with a full one on substrings of at least min_length characters, in both
+// orders, and compare the matches with those found by searching every substring of min_length characters
+// of the full index in the other one with ssa_search
+static void run_join(const ssa_index_t* index, const ssa_index_t* sample, size_t min_length) {
+    join_hit_list_t found = { NULL, 0, 0, 0 };
+    double start = now_seconds();
+    int64_t joined = ssa_join(index, sample, min_length, collect_join_hit, &found);
+    double join_elapsed = now_seconds() - start;
+
+    join_hit_list_t swapped = { NULL, 0, 0, 1 };
+    int64_t swapped_joined = ssa_join(sample, index, min_length, collect_join_hit, &swapped);
+
+    if (joined < 0 || swapped_joined < 0) {
+        printf("%-8zu %12s\n", min_length, index->sparseness_factor > min_length ? "rejected, L < k" : "failed");
+        free(found.hits);
+        free(swapped.hits);
+        return;
+    }
+
+    join_hit_list_t expected = { NULL, 0, 0, 0 };
+    join_reference_t reference = { index, sample, 0, &expected };
+    start = now_seconds();
+    for (size_t p = 0; p + min_length <= sample->text_len; p++) {
+        if (ssa_separator_free_length(sample->text + p, min_length) == min_length) {
+            reference.position_b = p;
+            ssa_search(index, sample->text + p, min_length, SEARCH_LCP, collect_reference_hit, &reference);
+        }
+    }
+    double reference_elapsed = now_seconds() - start;
+
+    qsort(found.hits, found.n_hits, sizeof(join_hit_t), compare_join_hit);
+    qsort(swapped.hits, swapped.n_hits, sizeof(join_hit_t), compare_join_hit);
+    qsort(expected.hits, expected.n_hits, sizeof(join_hit_t), compare_join_hit);
+    size_t size = expected.n_hits * sizeof(join_hit_t);
+    int match = found.n_hits == expected.n_hits && swapped.n_hits == expected.n_hits
+        && (size == 0 || (memcmp(found.hits, expected.hits, size) == 0 && memcmp(swapped.hits, expected.hits, size) == 0));
+
+    printf("%-8zu %12zu %12.2f %16.2f %14s\n", min_length, found.n_hits, join_elapsed * 1e3, reference_elapsed * 1e3, match ? "yes" : "NO");
+    free(found.hits);
+    free(swapped.hits);
+    free(expected.hits);
+}
+
+typedef struct {
+    repeat_t* repeats;
+    size_t n_repeats;
+    size_t capacity;
+} repeat_list_t;
+
+static void collect_repeat(const repeat_t* repeat, void* data) {
+    repeat_list_t* list = data;
+    if (list->n_repeats == list->capacity) {
+        list->capacity = list->capacity == 0 ? 1024 : 2 * list->capacity;
+        list->repeats = realloc(list->repeats, list->capacity * sizeof(repeat_t));
+    }
+    list->repeats[list->n_repeats++] = *repeat;
+}
+
+static const uint8_t* kmer_text;
+static size_t kmer_length;
+
+static int compare_kmer(const void* a, const void* b) {
+    return memcmp(kmer_text + *(const int64_t*) a, kmer_text + *(const int64_t*) b, kmer_length);
+}
+
+static int compare_count_desc(const void* a, const void* b) {
+    size_t x = *(const size_t*) a;
+    size_t y = *(const size_t*) b;
+    return (x < y) - (x > y);
+}
+
+// Function to count the occurrences of a substring of the text by trying it at every position
+static size_t count_occurrences(const ssa_index_t* index, int64_t position, size_t length) {
+    size_t count = 0;
+    for (size_t p = 0; p + length <= index->text_len; p++) {
+        count += memcmp(index->text + p, index->text + position, length) == 0;
+    }
+    return count;
+}
+
+// Function to check the repeats of at least L characters and the most frequent substrings of L characters
+// of a full index against a count of every substring of L characters of its text, sorted by content: every
+// reported count must be the number of occurrences of its substring, every substring of L characters that
+// occurs more than once must start a repeat with the same count, and the top counts must be the largest ones
+static void run_repeats(const ssa_index_t* index, size_t length) {
+    repeat_list_t list = { NULL, 0, 0 };
+    double start = now_seconds();
+    int64_t n_repeats = ssa_enumerate_repeats(index, length, collect_repeat, &list);
+    double enumerate_elapsed = now_seconds() - start;
+
+    repeat_t top[REPEATS_TOP];
+    start = now_seconds();
+    int64_t n_top = ssa_top_frequent(index, length, REPEATS_TOP, top);
+    double top_elapsed = now_seconds() - start;
+
+    if (n_repeats < 0 || n_top < 0) {
+        printf("%-8zu %10s\n", length, "failed");
+        free(list.repeats);
+        return;
+    }
+
+    start = now_seconds();
+    int64_t* kmers = malloc(index->text_len * sizeof(int64_t));
+    size_t* counts = malloc(index->text_len * sizeof(size_t));
+    size_t n_kmers = 0, n_counts = 0;
+    for (size_t p = 0; p + length <= index->text_len; p++) {
+        if (ssa_separator_free_length(index->text + p, length) == length) {
+            kmers[n_kmers++] = (int64_t) p;
+        }
+    }
+    kmer_text = index->text;
+    kmer_length = length;
+    qsort(kmers, n_kmers, sizeof(int64_t), compare_kmer);
+
+    int match = 1;
+    for (size_t i = 0; i < n_kmers; ) {
+        size_t j = i + 1;
+        while (j < n_kmers && compare_kmer(&kmers[i], &kmers[j]) == 0) {
+            j++;
+        }
+        counts[n_counts++] = j - i;
+        if (j - i > 1) {
+            int covered = 0;
+            for (size_t r = 0; r < list.n_repeats && !covered; r++) {
+                covered = list.repeats[r].count == j - i && memcmp(index->text + list.repeats[r].position, index->text + kmers[i], length) == 0;
+            }
+            match = match && covered;
+        }
+        i = j;
+    }
+    for (size_t r = 0; r < list.n_repeats && match; r++) {
+        match = list.repeats[r].length >= length && count_occurrences(index, list.repeats[r].position, list.repeats[r].length) == list.repeats[r].count;
+    }
+
+    qsort(counts, n_counts, sizeof(size_t), compare_count_desc);
+    match = match && (size_t) n_top == (n_counts < REPEATS_TOP ? n_counts : REPEATS_TOP);
+    for (int64_t i = 0; i < n_top && match; i++) {
+        match = top[i].length == length && top[i].count == counts[i] && count_occurrences(index, top[i].position, length) == top[i].count;
+    }
+    double scan_elapsed = now_seconds() - start;
+
+    printf("%-8zu %10zu %10zu %16.2f %10.2f %10.2f %12s\n", length, list.n_repeats, n_top > 0 ? top[0].count : 0,
+        enumerate_elapsed * 1e3, top_elapsed * 1e3, scan_elapsed * 1e3, match ? "yes" : "NO");
+    free(kmers);
+    free(counts);
+    free(list.repeats);
+}
+
+// Function to add a hit to the hit list of its query
+static void collect_query_hit(size_t query, int64_t position, void* data) {
+    hit_list_t* lists = data;
+    collect_hit(position, &lists[query]);
+}
+
+// Function to search a workload with its SA and text read from disk, in batches of batch_size queries. The
+// hits of every query are collected and compared, in order, with those of ssa_search.
+static void run_ssd(const ssa_index_t* index, const ssd_tier_t* tier, const char* sa_fn, const char* text_fn, const workload_t* workload, size_t batch_size) {
+    ssd_index_t ssd;
+    if (ssd_index_open(&ssd, tier, sa_fn, text_fn, SSD_CACHE_BLOCKS) != 0) {
+        perror("Failed to open index for SSD queries");
+        return;
+    }
+
+    const uint8_t** patterns = malloc(batch_size * sizeof(uint8_t*));
+    size_t* lengths = malloc(batch_size * sizeof(size_t));
+    size_t* hits = malloc(batch_size * sizeof(size_t));
+    hit_list_t* lists = calloc(workload->n_queries, sizeof(hit_list_t));
+    size_t n_hits = 0;
+    double start = now_seconds();
+    for (size_t first = 0; first < workload->n_queries; first += batch_size) {
+        size_t n = workload->n_queries - first < batch_size ? workload->n_queries - first : batch_size;
+        for (size_t i = 0; i < n; i++) {
+            patterns[i] = workload->queries[first + i].pattern;
+            lengths[i] = workload->queries[first + i].length;
+        }
+        if (ssd_search_batch(&ssd, patterns, lengths, n, collect_query_hit, lists + first, hits) != 0) {
+            perror("Failed to search batch");
+            break;
+        }
+        for (size_t i = 0; i < n; i++) {
+            n_hits += hits[i];
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    hit_list_t expected = { NULL, 0, 0 };
+    size_t mismatches = 0;
+    for (size_t i = 0; i < workload->n_queries; i++) {
+        expected.n_positions = 0;
+        ssa_search(index, workload->queries[i].pattern, workload->queries[i].length, SEARCH_LCP, collect_hit, &expected);
+        if (lists[i].n_positions != expected.n_positions
+                || (expected.n_positions > 0 && memcmp(lists[i].positions, expected.positions, expected.n_positions * sizeof(int64_t)) != 0)) {
+            mismatches++;
+        }
+        free(lists[i].positions);
+    }
+    free(expected.positions);
+
+    printf("%-10s %8zu %10.0f %14.2f %12.2f %10s\n", workload->name, batch_size, workload->n_queries / elapsed,
+        (double) ssd.blocks_read / workload->n_queries, (double) n_hits / workload->n_queries, mismatches == 0 ? "yes" : "NO");
+    free(patterns);
+    free(lengths);
+    free(hits);
+    free(lists);
+    ssd_index_close(&ssd);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    size_t n_queries = 10000, min_length = 5, max_length = 30;
+    int n_threads = 4;
+    uint64_t seed = 1;
+
+    while ((opt = getopt(argc, argv, "n:r:l:L:t:")) != -1) {
+        switch (opt) {
+            case 'n':
+                n_queries = strtoull(optarg, NULL, 10);
+                break;
+            case 'r':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'l':
+                min_length = strtoull(optarg, NULL, 10);
+                break;
+            case 'L':
+                max_length = strtoull(optarg, NULL, 10);
+                break;
+            case 't':
+                n_threads = atoi(optarg);
+                break;
+            default:
+                print_usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind + 2 != argc || min_length == 0 || max_length < min_length || n_queries == 0 || n_threads < 1) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+    rng_state ^= seed * 0xD1B54A32D192ED03ULL;
+
+    ssa_reader_t reader;
+    if (ssa_reader_open(&reader, argv[optind + 1], argv[optind]) != 0) {
+        perror("Failed to open index");
+        return EXIT_FAILURE;
+    }
+    const ssa_index_t* index = &reader.index;
+
+    // Build both layouts of the suffix array in memory, so they can be compared on the same workloads
+    size_t sa_length = index->sa_length;
+    uint64_t* plain_sa = malloc((sa_length + 1) * sizeof(uint64_t));
+    uint64_t* compressed_sa = malloc((sa_length + 1) * sizeof(uint64_t));
+    if (plain_sa == NULL || compressed_sa == NULL) {
+        perror("Failed to allocate memory for suffix array");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < sa_length; i++) {
+        plain_sa[i] = (uint64_t) ssa_index_get(index, i);
+    }
+    memcpy(compressed_sa, plain_sa, sa_length * sizeof(uint64_t));
+    uint8_t bits_per_element = (uint8_t) log2(sa_length * index->sparseness_factor) + 1;
+    size_t compressed_length = sa_length;
+    compress_sa(compressed_sa, &compressed_length, bits_per_element);
+
+    ssa_index_t plain, compressed;
+    ssa_index_init(&plain, index->text, index->text_len, plain_sa, sa_length, 64, index->sparseness_factor);
+    ssa_index_init(&compressed, index->text, index->text_len, compressed_sa, sa_length, bits_per_element, index->sparseness_factor);
+
+    printf("Generating workloads of %zu queries of length %zu-%zu on %zu suffixes (k = %d) ...\n",
+        n_queries, min_length, max_length, sa_length, index->sparseness_factor);
+
+    size_t n_peptides;
+    query_t* peptides = tryptic_digest(index, min_length, max_length, &n_peptides);
+
+    size_t pool_size = 0;
+    query_t* pool = malloc(n_queries * sizeof(query_t));
+    while (pool_size < n_queries && random_substring(index, min_length, max_length, &pool[pool_size])) {
+        pool_size++;
+    }
+
+    workload_t workloads[4];
+    workloads[0] = sample_uniform("tryptic", peptides, n_peptides, n_queries);
+    workloads[1] = sample_uniform("random", pool, pool_size, n_queries);
+    workloads[2] = sample_absent("absent", index, min_length, max_length, n_queries);
+    workloads[3] = n_peptides > 0 ? sample_skewed("skewed", peptides, n_peptides, n_queries) : sample_skewed("skewed", pool, pool_size, n_queries);
+    free(peptides);
+    free(pool);
+
+    cache_counters_t counters = { open_counter(PERF_COUNT_HW_CACHE_MISSES), open_counter(PERF_COUNT_HW_CACHE_REFERENCES) };
+
+    printf("%-10s %-8s %-10s %10s %10s %10s %12s %16s %8s\n", "layout", "search", "workload", "queries/s", "p50 (us)", "p99 (us)", "hits/query", "misses/query", "faults");
+    const ssa_index_t* layouts[2] = { &plain, &compressed };
+    const char* layout_names[2] = { "plain", "bitpacked" };
+    search_strategy_t strategies[2] = { SEARCH_BINARY, SEARCH_LCP };
+    for (int l = 0; l < 2; l++) {
+        for (int s = 0; s < 2; s++) {
+            for (int w = 0; w < 4; w++) {
+                run_workload(layout_names[l], layouts[l], strategies[s], &workloads[w], &counters);
+            }
+        }
+    }
+
+    run_text_store(index, &workloads[0]);
+
+    record_table_t records;
+    if (build_record_table(index->text, index->text_len, &records) != 0) {
+        perror("Failed to allocate memory for record table");
+        return EXIT_FAILURE;
+    }
+    printf("\n%-10s %10s %10s %16s %16s\n", "workload", "hits", "records", "search+qsort q/s", "locate q/s");
+    for (int w = 0; w < 4; w++) {
+        run_locate(&compressed, &records, &workloads[w], n_threads);
+    }
+
+    bucket_table_t buckets;
+    if (bucket_table_build(&compressed, &buckets) != 0) {
+        perror("Failed to allocate memory for bucket table");
+        return EXIT_FAILURE;
+    }
+    printf("\nbucket table: q = %zu, %zu buckets\n", buckets.q, buckets.n_buckets);
+    printf("%-10s %10s %12s %12s %16s %16s\n", "window", "windows", "hits", "stream hits", "search win/s", "stream win/s");
+    run_windows(&compressed, &buckets, &records, min_length, n_queries);
+    run_windows(&compressed, &buckets, &records, max_length, n_queries);
+    bucket_table_free(&buckets);
+    free_record_table(&records);
+
+    ssd_tier_t tier;
+    if (ssd_tier_build(&tier, index, SSD_DEFAULT_SAMPLE_RATE) != 0) {
+        perror("Failed to allocate memory for SSD tier");
+        return EXIT_FAILURE;
+    }
+    ssd_index_t probe;
+    const char* backend = "pread";
+    if (ssd_index_open(&probe, &tier, argv[optind + 1], argv[optind], 1) == 0) {
+        backend = block_io_uses_uring(&probe.io) ? "io_uring" : "pread";
+        ssd_index_close(&probe);
+    }
+    printf("\nssd tier: %zu bytes in RAM, %d blocks of cache, reads through %s\n", ssd_tier_size(&tier), SSD_CACHE_BLOCKS, backend);
+    printf("%-10s %8s %10s %14s %12s %10s\n", "workload", "batch", "queries/s", "blocks/query", "hits/query", "hits match");
+    for (int w = 0; w < 4; w++) {
+        run_ssd(index, &tier, argv[optind + 1], argv[optind], &workloads[w], 1);
+        run_ssd(index, &tier, argv[optind + 1], argv[optind], &workloads[w], SSD_BATCH_SIZE);
+    }
+    ssd_tier_free(&tier);
+
+    const char* motifs[] = { "N-{P}-[ST]-{P}", "[ST]-x-[RK]", "C-x(2,4)-C", "<M-x(2)-[DE]", "[RK](2)-x(0,2)-[ST]", "W-x(1,3)-W>" };
+    printf("\n%-24s %10s %14s %14s %10s\n", "motif", "hits", "search (ms)", "scan (ms)", "hits match");
+    for (size_t m = 0; m < sizeof(motifs) / sizeof(motifs[0]); m++) {
+        run_motif(&compressed, motifs[m]);
+    }
+
+    ssa_index_t sample;
+    uint8_t* sample_text;
+    int64_t* sample_sa;
+    if (build_sample_index(index, JOIN_SAMPLE_PIECES, JOIN_SAMPLE_PIECE_LENGTH, &sample, &sample_text, &sample_sa) != 0) {
+        perror("Failed to allocate memory for sample index");
+        return EXIT_FAILURE;
+    }
+    printf("\njoin with a full index of %d random substrings of %d characters (k = %d)\n", JOIN_SAMPLE_PIECES, JOIN_SAMPLE_PIECE_LENGTH, index->sparseness_factor);
+    printf("%-8s %12s %12s %16s %14s\n", "L", "matches", "join (ms)", "reference (ms)", "matches match");
+    run_join(&compressed, &sample, min_length);
+    run_join(&compressed, &sample, max_length);
+    if (index->sparseness_factor > 1) {
+        printf("join of two sparse indexes %s\n", ssa_join(&compressed, &compressed, max_length, NULL, NULL) < 0 ? "rejected" : "NOT rejected");
+    }
+
+    printf("\nrepeats of the full index of random substrings, top %d counts\n", REPEATS_TOP);
+    printf("%-8s %10s %10s %16s %10s %10s %12s\n", "L", "repeats", "top count", "enumerate (ms)", "top (ms)", "scan (ms)", "counts match");
+    run_repeats(&sample, min_length);
+    run_repeats(&sample, max_length);
+    if (index->sparseness_factor > 1) {
+        int rejected = ssa_enumerate_repeats(&compressed, min_length, NULL, NULL) < 0 && ssa_top_frequent(&compressed, min_length, 1, NULL) < 0;
+        printf("repeats of a sparse index %s\n", rejected ? "rejected" : "NOT rejected");
+    }
+    ssa_index_free(&sample);
+    free(sample_text);
+    free(sample_sa);
+
+    for (int w = 0; w < 4; w++) {
+        free_workload(&workloads[w]);
+    }
+    if (counters.misses_fd >= 0) {
+        close(counters.misses_fd);
+    }
+    if (counters.references_fd >= 0) {
+        close(counters.references_fd);
+    }
+    ssa_index_free(&plain);
+    ssa_index_free(&compressed);
+    free(plain_sa);
+    free(compressed_sa);
+    ssa_reader_close(&reader);
+    return 0;
+}
@@ -0,0 +1,182 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "block_io.h"
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(SYS_io_uring_setup) && defined(SYS_io_uring_enter)
+    #include <linux/io_uring.h>
+    #define HAS_IO_URING
+#endif
+
+// Function to set up an io_uring of BLOCK_IO_DEPTH entries. When the kernel has none, or it is disabled,
+// all reads are done with pread instead.
+void block_io_init(block_io_t* io) {
+    memset(io, 0, sizeof(block_io_t));
+    io->ring_fd = -1;
+
+#if defined(HAS_IO_URING)
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ring_fd = (int) syscall(SYS_io_uring_setup, BLOCK_IO_DEPTH, &params);
+    if (ring_fd < 0) {
+        return;
+    }
+
+    io->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    io->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_map && io->cq_map_size > io->sq_map_size) {
+        io->sq_map_size = io->cq_map_size;
+    }
+
+    void* sq_map = mmap(NULL, io->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    void* cq_map = sq_map;
+    if (!single_map && sq_map != MAP_FAILED) {
+        cq_map = mmap(NULL, io->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    }
+    io->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = sq_map != MAP_FAILED && cq_map != MAP_FAILED
+        ? mmap(NULL, io->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES) : MAP_FAILED;
+    if (sqes == MAP_FAILED) {
+        if (cq_map != MAP_FAILED && cq_map != sq_map) {
+            munmap(cq_map, io->cq_map_size);
+        }
+        if (sq_map != MAP_FAILED) {
+            munmap(sq_map, io->sq_map_size);
+        }
+        close(ring_fd);
+        memset(io, 0, sizeof(block_io_t));
+        io->ring_fd = -1;
+        return;
+    }
+
+    io->ring_fd = ring_fd;
+    io->depth = params.sq_entries;
+    io->sq_map = sq_map;
+    io->cq_map = cq_map;
+    io->sqes = sqes;
+    io->sq_head = (unsigned*) (io->sq_map + params.sq_off.head);
+    io->sq_tail = (unsigned*) (io->sq_map + params.sq_off.tail);
+    io->sq_mask = (unsigned*) (io->sq_map + params.sq_off.ring_mask);
+    io->sq_array = (unsigned*) (io->sq_map + params.sq_off.array);
+    io->cq_head = (unsigned*) (io->cq_map + params.cq_off.head);
+    io->cq_tail = (unsigned*) (io->cq_map + params.cq_off.tail);
+    io->cq_mask = (unsigned*) (io->cq_map + params.cq_off.ring_mask);
+    io->cqes = io->cq_map + params.cq_off.cqes;
+#endif
+}
+
+int block_io_uses_uring(const block_io_t* io) {
+    return io->ring_fd >= 0;
+}
+
+// Function to read the rest of a read that came back short, which may happen at any time for a read
+// through the ring, until the end of the file. A read that fails after some bytes keeps those, so the
+// caller sees it came back short.
+static void complete_read(block_read_t* read) {
+    while (read->result >= 0 && (size_t) read->result < read->length) {
+        ssize_t n = pread(read->fd, read->buffer + read->result, read->length - read->result, read->offset + read->result);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            read->result = n < 0 && read->result == 0 ? -errno : read->result;
+            return;
+        }
+        read->result += n;
+    }
+}
+
+#if defined(HAS_IO_URING)
+// Function to submit up to `depth` reads to the ring and wait for all of them to complete
+static int ring_read(block_io_t* io, block_read_t* reads, size_t n_reads) {
+    struct io_uring_sqe* sqes = io->sqes;
+    struct io_uring_cqe* cqes = io->cqes;
+
+    unsigned tail = *io->sq_tail;
+    for (size_t i = 0; i < n_reads; i++) {
+        unsigned slot = tail & *io->sq_mask;
+        struct io_uring_sqe* sqe = &sqes[slot];
+        memset(sqe, 0, sizeof(struct io_uring_sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = reads[i].fd;
+        sqe->addr = (uint64_t) (uintptr_t) reads[i].buffer;
+        sqe->len = (uint32_t) reads[i].length;
+        sqe->off = reads[i].offset;
+        sqe->user_data = i;
+        io->sq_array[slot] = slot;
+        tail++;
+    }
+    __atomic_store_n(io->sq_tail, tail, __ATOMIC_RELEASE);
+
+    size_t to_submit = n_reads;
+    size_t completed = 0;
+    while (completed < n_reads) {
+        int ret = (int) syscall(SYS_io_uring_enter, io->ring_fd, (unsigned) to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return -1;
+        }
+        if (ret > 0) {
+            to_submit -= (size_t) ret < to_submit ? (size_t) ret : to_submit;
+        }
+
+        unsigned head = *io->cq_head;
+        unsigned cq_tail = __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != cq_tail) {
+            struct io_uring_cqe* cqe = &cqes[head & *io->cq_mask];
+            if (cqe->user_data < n_reads) {
+                reads[cqe->user_data].result = cqe->res;
+                completed++;
+            }
+            head++;
+        }
+        __atomic_store_n(io->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+#endif
+
+// Function to do a batch of reads and wait for all of them. Through the ring, up to BLOCK_IO_DEPTH reads are
+// in flight at once, so the device can serve them in parallel. Reads that come back short are completed
+// with pread. Returns -1 if the ring fails, the results of the single reads have their own errors.
+int block_io_read(block_io_t* io, block_read_t* reads, size_t n_reads) {
+#if defined(HAS_IO_URING)
+    if (io->ring_fd >= 0) {
+        for (size_t start = 0; start < n_reads; start += io->depth) {
+            size_t n = n_reads - start < io->depth ? n_reads - start : io->depth;
+            if (ring_read(io, reads + start, n) != 0) {
+                return -1;
+            }
+        }
+        for (size_t i = 0; i < n_reads; i++) {
+            complete_read(&reads[i]);
+        }
+        return 0;
+    }
+#endif
+
+    for (size_t i = 0; i < n_reads; i++) {
+        reads[i].result = 0;
+        complete_read(&reads[i]);
+    }
+    return 0;
+}
+
+void block_io_free(block_io_t* io) {
+    if (io->ring_fd >= 0) {
+        munmap(io->sqes, io->sqes_size);
+        if (io->cq_map != io->sq_map) {
+            munmap(io->cq_map, io->cq_map_size);
+        }
+        munmap(io->sq_map, io->sq_map_size);
+        close(io->ring_fd);
+    }
+    memset(io, 0, sizeof(block_io_t));
+    io->ring_fd = -1;
+}
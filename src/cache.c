@@ -0,0 +1,223 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static uint64_t hash_merge_round(uint64_t acc, uint64_t value) {
+    acc ^= hash_round(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+// Function to hash a buffer with XXH64, which runs at memory speed so hashing an input costs less than reading it
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed) {
+    const uint8_t* p = (const uint8_t*) data;
+    const uint8_t* end = p + length;
+    uint64_t h;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        do {
+            v1 = hash_round(v1, read64(p));
+            v2 = hash_round(v2, read64(p + 8));
+            v3 = hash_round(v3, read64(p + 16));
+            v4 = hash_round(v4, read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = hash_merge_round(h, v1);
+        h = hash_merge_round(h, v2);
+        h = hash_merge_round(h, v3);
+        h = hash_merge_round(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+
+    h += (uint64_t) length;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= hash_round(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t) read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static char* cache_path(const char* cache_dir, uint64_t key, const char* extension) {
+    size_t length = strlen(cache_dir) + 16 + strlen(extension) + 3;
+    char* path = malloc(length);
+    if (path != NULL) {
+        snprintf(path, length, "%s/%016llx.%s", cache_dir, (unsigned long long) key, extension);
+    }
+    return path;
+}
+
+// Function to atomically write a cache entry, so concurrent builds never see a partially written file
+static int cache_write(const char* cache_dir, uint64_t key, const char* extension, const void* data, size_t size) {
+    if (mkdir(cache_dir, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    char* path = cache_path(cache_dir, key, extension);
+    if (path == NULL) {
+        return -1;
+    }
+    size_t tmp_length = strlen(path) + 32;
+    char* tmp_path = malloc(tmp_length);
+    if (tmp_path == NULL) {
+        free(path);
+        return -1;
+    }
+    snprintf(tmp_path, tmp_length, "%s.tmp.%ld", path, (long) getpid());
+
+    int result = -1;
+    FILE* file = fopen(tmp_path, "wb");
+    if (file != NULL) {
+        size_t written = fwrite(data, 1, size, file);
+        if (fclose(file) == 0 && written == size && rename(tmp_path, path) == 0) {
+            result = 0;
+        } else {
+            remove(tmp_path);
+        }
+    }
+
+    free(tmp_path);
+    free(path);
+    return result;
+}
+
+static void* cache_read(const char* cache_dir, uint64_t key, const char* extension, size_t* size) {
+    char* path = cache_path(cache_dir, key, extension);
+    if (path == NULL) {
+        return NULL;
+    }
+    FILE* file = fopen(path, "rb");
+    free(path);
+    if (file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    rewind(file);
+
+    void* data = length > 0 ? malloc(length) : NULL;
+    if (data != NULL && fread(data, 1, length, file) != (size_t) length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+
+    *size = data != NULL ? (size_t) length : 0;
+    return data;
+}
+
+// Function to derive a key from the identity of an input file (path, inode, size and modification time)
+static int file_stat_key(const char* input_fn, uint64_t* key) {
+    struct stat st;
+    if (stat(input_fn, &st) != 0) {
+        return -1;
+    }
+
+    uint64_t fields[6] = {
+        (uint64_t) st.st_dev,
+        (uint64_t) st.st_ino,
+        (uint64_t) st.st_size,
+        (uint64_t) st.st_mtim.tv_sec,
+        (uint64_t) st.st_mtim.tv_nsec,
+        (uint64_t) st.st_ctim.tv_sec
+    };
+    *key = hash_bytes(fields, sizeof(fields), hash_bytes(input_fn, strlen(input_fn), 0));
+    return 0;
+}
+
+// Function to look up the content hash of an unchanged input file, without reading the file itself
+int cache_lookup_file_hash(const char* cache_dir, const char* input_fn, uint64_t* content_hash) {
+    uint64_t key;
+    if (file_stat_key(input_fn, &key) != 0) {
+        return -1;
+    }
+
+    size_t size;
+    uint64_t* stored = cache_read(cache_dir, key, "hash", &size);
+    if (stored == NULL || size != sizeof(uint64_t)) {
+        free(stored);
+        return -1;
+    }
+    *content_hash = *stored;
+    free(stored);
+    return 0;
+}
+
+int cache_store_file_hash(const char* cache_dir, const char* input_fn, uint64_t content_hash) {
+    uint64_t key;
+    if (file_stat_key(input_fn, &key) != 0) {
+        return -1;
+    }
+    return cache_write(cache_dir, key, "hash", &content_hash, sizeof(content_hash));
+}
+
+int64_t* cache_load_sa(const char* cache_dir, uint64_t key, size_t* sa_length) {
+    size_t size;
+    int64_t* sa = cache_read(cache_dir, key, "sa", &size);
+    if (sa != NULL && size % sizeof(int64_t) != 0) {
+        free(sa);
+        return NULL;
+    }
+    *sa_length = size / sizeof(int64_t);
+    return sa;
+}
+
+int cache_store_sa(const char* cache_dir, uint64_t key, const int64_t* sa, size_t sa_length) {
+    return cache_write(cache_dir, key, "sa", sa, sa_length * sizeof(int64_t));
+}
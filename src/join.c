@@ -0,0 +1,167 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "join.h"
+
+typedef struct {
+    int64_t* positions;
+    size_t length;
+    size_t capacity;
+} join_block_t;
+
+typedef struct {
+    const ssa_index_t* index;
+    size_t i;
+    int64_t position;
+} join_cursor_t;
+
+// Function to move the cursor to the next suffix that starts with min_length characters of a single record
+static void cursor_advance(join_cursor_t* cursor, size_t min_length) {
+    const ssa_index_t* index = cursor->index;
+    while (cursor->i < index->sa_length) {
+        size_t p = (size_t) ssa_index_get(index, cursor->i++);
+        if (p + min_length <= index->text_len && ssa_separator_free_length(index->text + p, min_length) == min_length) {
+            cursor->position = (int64_t) p;
+            return;
+        }
+    }
+    cursor->position = -1;
+}
+
+static int block_push(join_block_t* block, int64_t position) {
+    if (block->length == block->capacity) {
+        size_t capacity = block->capacity == 0 ? 64 : 2 * block->capacity;
+        int64_t* positions = realloc(block->positions, capacity * sizeof(int64_t));
+        if (positions == NULL) {
+            return -1;
+        }
+        block->positions = positions;
+        block->capacity = capacity;
+    }
+    block->positions[block->length++] = position;
+    return 0;
+}
+
+// Function to report all pairs of a block of suffixes that share their first characters, as matches that
+// start `offset` characters before both suffixes. The characters before the suffixes are verified against
+// the text, and a pair is skipped when the match extends further to the left, so it is reported at the
+// pair where it starts.
+static size_t flush_block(const ssa_index_t* a, const ssa_index_t* b, const join_block_t* block_a, const join_block_t* block_b, size_t offset, join_hit_callback callback, void* data) {
+    size_t hits = 0;
+    for (size_t x = 0; x < block_a->length; x++) {
+        if ((size_t) block_a->positions[x] < offset) {
+            continue;
+        }
+        size_t pa = (size_t) block_a->positions[x] - offset;
+        for (size_t y = 0; y < block_b->length; y++) {
+            if ((size_t) block_b->positions[y] < offset) {
+                continue;
+            }
+            size_t pb = (size_t) block_b->positions[y] - offset;
+
+            if (packed_lcp(a->text + pa, offset, b->text + pb, offset) != offset
+                || ssa_separator_free_length(a->text + pa, offset) != offset) {
+                continue;
+            }
+            if (pa > 0 && pb > 0 && a->text[pa - 1] == b->text[pb - 1] && !ssa_is_separator(a->text[pa - 1])) {
+                continue;
+            }
+
+            size_t length = packed_lcp(a->text + pa, a->text_len - pa, b->text + pb, b->text_len - pb);
+            length = ssa_separator_free_length(a->text + pa, length);
+
+            hits++;
+            if (callback != NULL) {
+                callback((int64_t) pa, (int64_t) pb, length, data);
+            }
+        }
+    }
+    return hits;
+}
+
+// Function to join the suffixes of both indexes on their first min_length characters, in one merge-like
+// pass over both suffix arrays, and report the matches that start `offset` characters earlier. Returns the
+// number of reported matches, or -1 when memory runs out.
+static int64_t join_pass(const ssa_index_t* a, const ssa_index_t* b, size_t min_length, size_t offset, join_hit_callback callback, void* data) {
+    join_cursor_t cursor_a = { a, 0, -1 };
+    join_cursor_t cursor_b = { b, 0, -1 };
+    cursor_advance(&cursor_a, min_length);
+    cursor_advance(&cursor_b, min_length);
+
+    join_block_t block_a = { NULL, 0, 0 };
+    join_block_t block_b = { NULL, 0, 0 };
+    const uint8_t* head = NULL;
+    int64_t hits = 0;
+
+    while (cursor_a.position >= 0 || cursor_b.position >= 0) {
+        // Take the smallest suffix of both cursors, preferring the first index on ties
+        int take_a = cursor_b.position < 0;
+        if (cursor_a.position >= 0 && cursor_b.position >= 0) {
+            take_a = packed_compare(a->text + cursor_a.position, min_length, b->text + cursor_b.position, min_length, NULL) <= 0;
+        }
+        join_cursor_t* cursor = take_a ? &cursor_a : &cursor_b;
+        const uint8_t* suffix = cursor->index->text + cursor->position;
+
+        if (head != NULL && packed_lcp(head, min_length, suffix, min_length) < min_length) {
+            if (block_a.length > 0 && block_b.length > 0) {
+                hits += flush_block(a, b, &block_a, &block_b, offset, callback, data);
+            }
+            block_a.length = 0;
+            block_b.length = 0;
+            head = NULL;
+        }
+        if (head == NULL) {
+            head = suffix;
+        }
+
+        if (block_push(take_a ? &block_a : &block_b, cursor->position) != 0) {
+            hits = -1;
+            break;
+        }
+        cursor_advance(cursor, min_length);
+    }
+
+    if (hits >= 0 && block_a.length > 0 && block_b.length > 0) {
+        hits += flush_block(a, b, &block_a, &block_b, offset, callback, data);
+    }
+
+    free(block_a.positions);
+    free(block_b.positions);
+    return hits;
+}
+
+// Function to report all common substrings of at least min_length characters between two indexes. Matches
+// never cross a record separator and are reported once, where they start in both texts, with their full
+// length. Comparisons are cut off at min_length, so suffixes with the same first min_length characters end
+// up in one block, and every pair of a block is a match. One of both indexes may be sparse: a match then
+// starts j < k characters before a sampled suffix, so the join takes k passes, one for every j, that cut
+// off at min_length - j and verify the first j characters against the text, as ssa_search does. Returns
+// the number of reported matches, or -1 when both indexes are sparse, min_length is less than the
+// sparseness factor, or memory runs out.
+int64_t ssa_join(const ssa_index_t* a, const ssa_index_t* b, size_t min_length, join_hit_callback callback, void* data) {
+    if (min_length == 0) {
+        return 0;
+    }
+
+    size_t k_a = a->sparseness_factor > 0 ? a->sparseness_factor : 1;
+    size_t k_b = b->sparseness_factor > 0 ? b->sparseness_factor : 1;
+    if (k_a > 1 && k_b > 1) {
+        return -1;
+    }
+    size_t sparseness_factor = k_a > k_b ? k_a : k_b;
+    if (min_length < sparseness_factor) {
+        return -1;
+    }
+
+    int64_t hits = 0;
+    for (size_t offset = 0; offset < sparseness_factor; offset++) {
+        int64_t pass_hits = join_pass(a, b, min_length - offset, offset, callback, data);
+        if (pass_hits < 0) {
+            return -1;
+        }
+        hits += pass_hits;
+    }
+    return hits;
+}
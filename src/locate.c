@@ -0,0 +1,293 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "locate.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define MAX_THREADS 256
+// Below this number of positions, a comparison sort is faster than the radix sort passes
+#define RADIX_THRESHOLD 1024
+
+typedef struct {
+    const ssa_index_t* index;
+    const uint8_t* pattern;
+    size_t pattern_len;
+    const search_interval_t* intervals;
+    size_t n_intervals;
+    const record_table_t* records;
+    int64_t* keys;
+    int64_t* sorted;
+    locate_result_t* result;
+} locate_job_t;
+
+// The part of the work done by one thread: a range of candidates, positions or groups
+typedef struct {
+    locate_job_t* job;
+    size_t start;
+    size_t count;
+    size_t output;
+    int shift;
+    size_t histogram[RADIX_BUCKETS];
+} locate_task_t;
+
+// Function to run a phase on all tasks, the last one on the calling thread. A task runs on the calling
+// thread as well if its thread cannot be started.
+static void run_parallel(locate_task_t* tasks, int n_tasks, void* (*phase)(void*)) {
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS];
+    for (int t = 0; t < n_tasks - 1; t++) {
+        started[t] = pthread_create(&threads[t], NULL, phase, &tasks[t]) == 0;
+        if (!started[t]) {
+            phase(&tasks[t]);
+        }
+    }
+    phase(&tasks[n_tasks - 1]);
+    for (int t = 0; t < n_tasks - 1; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+}
+
+// Function to divide `n` items evenly over the tasks
+static void split_evenly(locate_task_t* tasks, int n_tasks, size_t n) {
+    for (int t = 0; t < n_tasks; t++) {
+        tasks[t].start = n * t / n_tasks;
+        tasks[t].count = n * (t + 1) / n_tasks - tasks[t].start;
+    }
+}
+
+// Phase to decode and verify a range of candidate suffixes, over all intervals as if they were one.
+// Occurrences are written to the start of the range, their number replaces the size of the range.
+static void* decode_phase(void* data) {
+    locate_task_t* task = data;
+    const locate_job_t* job = task->job;
+
+    size_t candidate = task->start;
+    size_t end = task->start + task->count;
+    size_t written = 0;
+    size_t interval_start = 0;
+    for (size_t j = 0; j < job->n_intervals && candidate < end; j++) {
+        const search_interval_t* interval = &job->intervals[j];
+        size_t interval_end = interval_start + (interval->upper - interval->lower);
+        for (; candidate < end && candidate < interval_end; candidate++) {
+            int64_t suffix = ssa_index_get(job->index, interval->lower + (candidate - interval_start));
+            int64_t position;
+            if (ssa_verify_hit(job->index, job->pattern, job->pattern_len, interval, suffix, &position)) {
+                job->keys[task->start + written++] = position;
+            }
+        }
+        interval_start = interval_end;
+    }
+
+    task->count = written;
+    return NULL;
+}
+
+static void* histogram_phase(void* data) {
+    locate_task_t* task = data;
+    const int64_t* keys = task->job->keys + task->start;
+    memset(task->histogram, 0, sizeof(task->histogram));
+    for (size_t i = 0; i < task->count; i++) {
+        task->histogram[((uint64_t) keys[i] >> task->shift) & (RADIX_BUCKETS - 1)]++;
+    }
+    return NULL;
+}
+
+// Phase to move the keys of a task to their bucket, the histogram holds the first free slot of every bucket
+static void* scatter_phase(void* data) {
+    locate_task_t* task = data;
+    const int64_t* keys = task->job->keys + task->start;
+    int64_t* sorted = task->job->sorted;
+    for (size_t i = 0; i < task->count; i++) {
+        sorted[task->histogram[((uint64_t) keys[i] >> task->shift) & (RADIX_BUCKETS - 1)]++] = keys[i];
+    }
+    return NULL;
+}
+
+// Function to find whether the sorted position at index i starts a new group, and its record
+static int starts_group(const locate_job_t* job, size_t i, size_t* record) {
+    const int64_t* positions = job->result->positions;
+    if (i == 0 || positions[i] >= job->records->offsets[*record + 1]) {
+        // Records of consecutive positions are usually close, so they are found by a short scan
+        size_t r = i == 0 ? record_of(job->records, positions[0]) : *record;
+        while (r + 1 < job->records->n_records && job->records->offsets[r + 1] <= positions[i]) {
+            r++;
+        }
+        *record = r;
+        return 1;
+    }
+    return 0;
+}
+
+static void* count_groups_phase(void* data) {
+    locate_task_t* task = data;
+    size_t record = 0;
+    size_t groups = 0;
+    if (task->count > 0 && task->start > 0) {
+        record = record_of(task->job->records, task->job->result->positions[task->start - 1]);
+    }
+    for (size_t i = task->start; i < task->start + task->count; i++) {
+        groups += starts_group(task->job, i, &record);
+    }
+    task->output = groups;
+    return NULL;
+}
+
+// Phase to write the groups of a task, starting at the group index in `output`
+static void* fill_groups_phase(void* data) {
+    locate_task_t* task = data;
+    locate_result_t* result = task->job->result;
+    size_t record = 0;
+    size_t group = task->output;
+    if (task->count > 0 && task->start > 0) {
+        record = record_of(task->job->records, result->positions[task->start - 1]);
+    }
+    for (size_t i = task->start; i < task->start + task->count; i++) {
+        if (starts_group(task->job, i, &record)) {
+            result->group_starts[group] = i;
+            result->records[group] = (uint32_t) record;
+            group++;
+        }
+    }
+    return NULL;
+}
+
+static int compare_position(const void* a, const void* b) {
+    int64_t x = *(const int64_t*) a;
+    int64_t y = *(const int64_t*) b;
+    return (x > y) - (x < y);
+}
+
+static void collect_tail_hit(int64_t position, void* data) {
+    locate_job_t* job = data;
+    job->keys[job->result->n_positions++] = position;
+}
+
+// Function to find all occurrences of a pattern, sorted by position and grouped by record when a record
+// table is given. SA entries are text positions already, so they are not rescaled by the sparseness
+// factor. The candidates are decoded and verified, radix sorted and grouped by `n_threads` threads.
+// Returns -1 if memory runs out.
+int ssa_locate(const ssa_index_t* index, const uint8_t* pattern, size_t pattern_len, search_strategy_t strategy, const record_table_t* records, int n_threads, locate_result_t* result) {
+    memset(result, 0, sizeof(locate_result_t));
+
+    search_interval_t intervals[SEARCH_MAX_INTERVALS];
+    size_t n_intervals = ssa_search_intervals(index, pattern, pattern_len, strategy, intervals);
+    size_t n_candidates = 0;
+    for (size_t j = 0; j < n_intervals; j++) {
+        n_candidates += intervals[j].upper - intervals[j].lower;
+    }
+    size_t n_tail = ssa_search_tail(index, pattern, pattern_len, NULL, NULL);
+
+    if (n_threads > MAX_THREADS) {
+        n_threads = MAX_THREADS;
+    }
+    if (n_threads < 1 || n_candidates < LOCATE_PARALLEL_THRESHOLD) {
+        n_threads = 1;
+    }
+
+    locate_job_t job = { index, pattern, pattern_len, intervals, n_intervals, records, NULL, NULL, result };
+    job.keys = malloc((n_candidates + n_tail + 1) * sizeof(int64_t));
+    locate_task_t* tasks = malloc(n_threads * sizeof(locate_task_t));
+    if (job.keys == NULL || tasks == NULL) {
+        free(job.keys);
+        free(tasks);
+        return -1;
+    }
+    for (int t = 0; t < n_threads; t++) {
+        tasks[t].job = &job;
+    }
+
+    // Decode and verify, then move the occurrences of every task together
+    split_evenly(tasks, n_threads, n_candidates);
+    run_parallel(tasks, n_threads, decode_phase);
+    for (int t = 0; t < n_threads; t++) {
+        memmove(job.keys + result->n_positions, job.keys + tasks[t].start, tasks[t].count * sizeof(int64_t));
+        result->n_positions += tasks[t].count;
+    }
+    ssa_search_tail(index, pattern, pattern_len, collect_tail_hit, &job);
+
+    // Least significant digit radix sort, with as many passes as the largest position needs
+    int passes = 1;
+    while (passes * RADIX_BITS < 64 && (index->text_len >> (passes * RADIX_BITS)) > 0) {
+        passes++;
+    }
+    if (result->n_positions < RADIX_THRESHOLD) {
+        qsort(job.keys, result->n_positions, sizeof(int64_t), compare_position);
+        passes = 0;
+    } else {
+        job.sorted = malloc(result->n_positions * sizeof(int64_t));
+        if (job.sorted == NULL) {
+            free(job.keys);
+            free(tasks);
+            memset(result, 0, sizeof(locate_result_t));
+            return -1;
+        }
+    }
+    split_evenly(tasks, n_threads, result->n_positions);
+    for (int pass = 0; pass < passes; pass++) {
+        for (int t = 0; t < n_threads; t++) {
+            tasks[t].shift = pass * RADIX_BITS;
+        }
+        run_parallel(tasks, n_threads, histogram_phase);
+
+        // Buckets are filled in order of the tasks, which keeps every pass stable
+        size_t offset = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            for (int t = 0; t < n_threads; t++) {
+                size_t count = tasks[t].histogram[b];
+                tasks[t].histogram[b] = offset;
+                offset += count;
+            }
+        }
+        run_parallel(tasks, n_threads, scatter_phase);
+
+        int64_t* swap = job.keys;
+        job.keys = job.sorted;
+        job.sorted = swap;
+    }
+    free(job.sorted);
+
+    // Count the groups, so the result fits a single allocation, then fill them in
+    result->positions = job.keys;
+    size_t n_groups = 0;
+    if (records != NULL && records->n_records > 0) {
+        run_parallel(tasks, n_threads, count_groups_phase);
+        for (int t = 0; t < n_threads; t++) {
+            size_t count = tasks[t].output;
+            tasks[t].output = n_groups;
+            n_groups += count;
+        }
+    }
+
+    size_t positions_size = result->n_positions * sizeof(int64_t);
+    size_t size = positions_size + (n_groups + 1) * sizeof(size_t) + n_groups * sizeof(uint32_t);
+    uint8_t* buffer = realloc(job.keys, size);
+    if (buffer == NULL) {
+        free(job.keys);
+        free(tasks);
+        memset(result, 0, sizeof(locate_result_t));
+        return -1;
+    }
+    result->positions = (int64_t*) buffer;
+    result->group_starts = (size_t*) (buffer + positions_size);
+    result->records = (uint32_t*) (buffer + positions_size + (n_groups + 1) * sizeof(size_t));
+    result->n_groups = n_groups;
+
+    if (n_groups > 0) {
+        run_parallel(tasks, n_threads, fill_groups_phase);
+    }
+    result->group_starts[n_groups] = result->n_positions;
+
+    free(tasks);
+    return 0;
+}
+
+void locate_result_free(locate_result_t* result) {
+    free(result->positions);
+    memset(result, 0, sizeof(locate_result_t));
+}
@@ -5,18 +5,37 @@
 #include <time.h>
 #include <math.h>
 #include <unistd.h> 
+#include <sys/stat.h>
 
+#include "arrow_ipc.h"
 #include "bitpacking.h"
+#include "cache.h"
 #include "libsais16x64.h"
 #include "libsais32x64.h"
 #include "libsais64.h"
-
+#include "memory_pressure.h"
+#include "records.h"
+#include "ssa_index.h"
+#include "strands.h"
+#include "subset.h"
+#include "trace.h"
+
+// With -m, the build pauses while more than this percentage of time is lost to stalls on memory
+#define MAX_MEMORY_PRESSURE 10.0
+// With -m, the longest pause in seconds before continuing with too little memory
+#define MAX_MEMORY_WAIT 600
 
 void print_usage() {
-    printf("Usage: ./build_ssa -s <sparseness> [-cdo] <input_file> <output_file>\n\n");
+    printf("Usage: ./build_ssa -s <sparseness> [-cuadmr] [-C <cache_dir>] [-I <id_file>] <input_file> <output_file>\n\n");
     printf("-s <sparseness>     : Defines the sparseness factor (an integer).\n");
     printf("-c                  : Flag to specify whether the output SA is compressed by bitpacking.\n");
     printf("-u                  : If enabled, the program will compute the SSA unoptimized, by computing the full SA and subsampling afterwards.\n");
+    printf("-C <cache_dir>      : Reuse the SA of an earlier build on identical input and parameters from this directory.\n");
+    printf("-r                  : Index both strands of DNA, by following every record by its reverse complement.\n");
+    printf("-a                  : Write the SA as an Arrow IPC file instead of the binary format.\n");
+    printf("-m                  : Adapt to the memory limit and pressure instead of risking to be killed: build without the full SA, spill to disk or pause.\n");
+    printf("-d                  : With -a, add the record of every suffix and write the record offsets to <output_file>.records.arrow.\n");
+    printf("-I <id_file>        : Only index the records with the IDs in this file, one per line, gathered from the FASTA input file with its .fai index.\n");
     printf("<input_file>        : The path to the input file containing the DNA data.\n");
     printf("<output_file>       : The path where the output will be saved.\n");
 }
@@ -54,6 +73,63 @@ uint8_t* read_text(char* input_fn, size_t* length) {
 
 }
 
+// Function to gather the records listed in an ID file from a FASTA file, through its .fai index, instead
+// of reading the whole file. The records are separated like the records of a text input file.
+uint8_t* read_subset(char* fasta_fn, char* ids_fn, size_t* length, record_table_t* records) {
+    char* fai_fn = malloc(strlen(fasta_fn) + sizeof(".fai"));
+    if (fai_fn == NULL) {
+        perror("Failed to allocate memory");
+        exit(1);
+    }
+    sprintf(fai_fn, "%s.fai", fasta_fn);
+
+    fasta_index_t index;
+    if (read_fasta_index(fai_fn, &index) != 0) {
+        fprintf(stderr, "Error: Failed to read FASTA index %s, which can be made with samtools faidx\n", fai_fn);
+        exit(1);
+    }
+
+    size_t n_ids;
+    char** ids = read_id_list(ids_fn, &n_ids);
+    if (ids == NULL) {
+        perror("Failed to read ID list");
+        exit(1);
+    }
+    if (n_ids == 0) {
+        fprintf(stderr, "Error: No IDs in %s\n", ids_fn);
+        exit(1);
+    }
+    for (size_t i = 0; i < n_ids; i++) {
+        if (find_fasta_record(&index, ids[i]) == NULL) {
+            fprintf(stderr, "Error: Record %s is not in %s\n", ids[i], fai_fn);
+            exit(1);
+        }
+    }
+
+    uint8_t* text = gather_records(fasta_fn, &index, ids, n_ids, length, records);
+    if (text == NULL) {
+        perror("Failed to gather records from FASTA file");
+        exit(1);
+    }
+    printf("Selected %zu of %zu records, %zu characters\n", n_ids, index.n_entries, *length);
+
+    free_id_list(ids, n_ids);
+    free_fasta_index(&index);
+    free(fai_fn);
+    return text;
+}
+
+// Function to replace the text by one with the reverse complement after every record, to index both strands
+uint8_t* index_both_strands(uint8_t* text, size_t* length) {
+    uint8_t* both = add_reverse_complements(text, *length, length);
+    free(text);
+    if (both == NULL) {
+        perror("Failed to allocate memory for reverse complements");
+        exit(1);
+    }
+    return both;
+}
+
 int64_t* allocate_sa(size_t sa_length) {
     // Allocate memory for the suffix array (sa)
     int64_t *sa = (int64_t *)malloc(sa_length * sizeof(int64_t));
@@ -66,40 +142,103 @@ int64_t* allocate_sa(size_t sa_length) {
     return sa;
 }
 
-int64_t* build_sa_optimized(uint8_t* text, size_t length, int64_t sparseness_factor, size_t sa_length, int dna) {
-    int64_t* sa = allocate_sa(sa_length);
+// Function to make room for the SA before sorting when memory is short: the packed text is moved to a
+// file-backed mapping that the kernel can page out, and the build pauses until enough memory is free
+void* make_room_for_sort(void* packed_text, size_t packed_size, uint64_t required, const char* spill_prefix, int* spilled) {
+    memory_status_t status;
+    read_memory_status(&status);
+    if (available_memory(&status) >= required + packed_size && status.pressure_full <= MAX_MEMORY_PRESSURE) {
+        return packed_text;
+    }
+
+    void* spill = spill_to_file(packed_text, packed_size, spill_prefix);
+    if (spill != NULL) {
+        free(packed_text);
+        packed_text = spill;
+        *spilled = 1;
+        printf("Spilled the packed text (%zu MiB) to disk\n", packed_size >> 20);
+    }
 
+    if (wait_for_memory(required, MAX_MEMORY_PRESSURE, MAX_MEMORY_WAIT) != 0) {
+        printf("Memory is still short after %ds, continuing anyway\n", MAX_MEMORY_WAIT);
+    }
+    return packed_text;
+}
+
+int64_t* build_sa_optimized(uint8_t* text, size_t length, int64_t sparseness_factor, size_t sa_length, int dna, const char* spill_prefix) {
     uint8_t orig_alph_size = 0;
     uint8_t* char_to_rank = build_char_to_rank(text, length, &orig_alph_size);
     uint8_t bits_per_char = ceil(log2(orig_alph_size));
 
     int64_t required_bits = bits_per_char * sparseness_factor;
-    
-    if (sparseness_factor == 1) {
+    TRACE_PROBE3(libsais_packed, pack_start, length, sa_length, required_bits);
 
-        libsais64(text, sa, sa_length, 0, NULL);
-        free(text);
-    
+    // The text is packed before the SA is allocated, so the text and the SA are never in memory together
+    void* packed_text = text;
+    size_t packed_width = sizeof(uint8_t);
+    if (sparseness_factor == 1) {
+        packed_text = text;
     } else if (required_bits <= 8) {
-        
-        uint8_t* packed_text = bitpack_text_8(text, length, sparseness_factor, sa_length, char_to_rank, bits_per_char);
+        packed_text = bitpack_text_8(text, length, sparseness_factor, sa_length, char_to_rank, bits_per_char);
         free(text);
-        libsais64(packed_text, sa, sa_length, 0, NULL);
-
     } else if (required_bits <= 16) {
-        
-        uint16_t* packed_text = bitpack_text_16(text, length, sparseness_factor, sa_length, char_to_rank, bits_per_char);
+        packed_text = bitpack_text_16(text, length, sparseness_factor, sa_length, char_to_rank, bits_per_char);
+        packed_width = sizeof(uint16_t);
         free(text);
-        libsais16x64(packed_text, sa, sa_length, 0, NULL);
-
     } else if (required_bits <= 32) {
-        
-        uint32_t* packed_text = bitpack_text_32(text, length, sparseness_factor, sa_length, char_to_rank, bits_per_char);
+        packed_text = bitpack_text_32(text, length, sparseness_factor, sa_length, char_to_rank, bits_per_char);
+        packed_width = sizeof(uint32_t);
         free(text);
-        libsais32x64(packed_text, sa, sa_length, 1 << required_bits, 0, NULL);
-
     } else {
         perror("Alphabet too big\n");
+        exit(1);
+    }
+    free(char_to_rank);
+    if (packed_text == NULL) {
+        perror("Failed to allocate memory for packed text");
+        exit(1);
+    }
+    TRACE_PROBE1(libsais_packed, pack_done, sa_length);
+
+    int spilled = 0;
+    if (spill_prefix != NULL) {
+        // Besides the SA, libsais32x64 allocates 8 buckets per packed symbol and libsais16x64 8 buckets per
+        // 16-bit symbol, of 32 bits for inputs below 2^31
+        uint64_t bucket_size = sizeof(int64_t);
+#if defined(LIBSAIS_DISPATCH_BUCKET32)
+        if (sa_length <= INT32_MAX) {
+            bucket_size = sizeof(int32_t);
+        }
+#endif
+        uint64_t required = sa_length * sizeof(int64_t);
+        if (required_bits > 16) {
+            required += 8 * ((uint64_t) 1 << required_bits) * bucket_size;
+        } else if (required_bits > 8) {
+            required += 8 * 65536 * bucket_size;
+        }
+        packed_text = make_room_for_sort(packed_text, sa_length * packed_width, required, spill_prefix, &spilled);
+    }
+
+    int64_t* sa = allocate_sa(sa_length);
+    int64_t result;
+    if (packed_width == sizeof(uint8_t)) {
+        result = libsais64((uint8_t*) packed_text, sa, sa_length, 0, NULL);
+    } else if (packed_width == sizeof(uint16_t)) {
+        result = libsais16x64((uint16_t*) packed_text, sa, sa_length, 0, NULL);
+    } else {
+        result = libsais32x64((uint32_t*) packed_text, sa, sa_length, (int64_t) 1 << required_bits, 0, NULL);
+    }
+    // libsais fails when it cannot allocate its buckets, of 8 counters per packed symbol
+    if (result != 0) {
+        fprintf(stderr, "Failed to sort the suffixes (libsais error %lld), use a smaller sparseness factor or -u\n", (long long) result);
+        exit(1);
+    }
+    TRACE_PROBE1(libsais_packed, sort_done, sa_length);
+
+    if (spilled) {
+        free_spill(packed_text, sa_length * packed_width);
+    } else {
+        free(packed_text);
     }
 
     if (sparseness_factor > 1) {
@@ -122,7 +261,12 @@ int64_t* build_sa(uint8_t* text, size_t length, int64_t sparseness_factor) {
         exit(1);
     }
 
-    libsais64(text, sa, length, 0, NULL);
+    if (libsais64(text, sa, length, 0, NULL) != 0) {
+        fprintf(stderr, "Failed to sort the suffixes\n");
+        free(text);
+        exit(1);
+    }
+    TRACE_PROBE1(libsais_packed, sort_done, length);
 
     // Sample the suffix array
     if (sparseness_factor > 1) {
@@ -138,29 +282,6 @@ int64_t* build_sa(uint8_t* text, size_t length, int64_t sparseness_factor) {
     return sa;
 }
 
-void compress_sa(uint64_t* sa, size_t* sa_length, uint8_t bits_per_element) {
-
-    int64_t element = 0;
-    int8_t shift_element = 64 - bits_per_element;
-    size_t compressed_i = 0;
-    for (size_t i = 0; i < *sa_length; i ++) {
-        if (shift_element < 0) { // new element does not fit in element
-            element |= sa[i] >> (-1 * shift_element);
-            sa[compressed_i] = element;
-            compressed_i ++;
-            element = 0;
-            shift_element += 64;
-        }
-        element |= sa[i] << shift_element;
-        shift_element -= bits_per_element;
-    }
-
-    sa[compressed_i] = element;
-
-    *sa_length = compressed_i + 1;
-}
-
-
 uint64_t* decompress_sa(uint64_t* sa, size_t orig_sa_length, uint8_t bits_per_element) {
     uint64_t*  decompressed_sa = malloc(orig_sa_length * sizeof(int64_t));
     
@@ -214,6 +335,74 @@ void write_sa(char* output_fn, uint8_t sparseness_factor, uint64_t* sa, size_t s
     fclose(output_file);
 }
 
+static void fill_sa_column(void* values, size_t start, size_t count, void* data) {
+    memcpy(values, (const int64_t*) data + start, count * sizeof(int64_t));
+}
+
+typedef struct {
+    const int64_t* sa;
+    const record_table_t* records;
+} document_column_t;
+
+static void fill_document_column(void* values, size_t start, size_t count, void* data) {
+    const document_column_t* column = data;
+    uint32_t* documents = values;
+    for (size_t i = 0; i < count; i++) {
+        documents[i] = (uint32_t) record_of(column->records, column->sa[start + i]);
+    }
+}
+
+static void fill_offset_column(void* values, size_t start, size_t count, void* data) {
+    memcpy(values, ((const record_table_t*) data)->offsets + start, count * sizeof(int64_t));
+}
+
+// Function to write the SA as an Arrow IPC file, optionally with the record of every suffix and a
+// second file with the record offsets, so the index can be joined with other tables by record
+void write_sa_arrow(char* output_fn, uint8_t sparseness_factor, int64_t* sa, size_t sa_length, record_table_t* records) {
+    char sparseness[4];
+    snprintf(sparseness, sizeof(sparseness), "%u", sparseness_factor);
+    arrow_metadata_t metadata[1] = { { "sparseness_factor", sparseness } };
+
+    document_column_t documents = { sa, records };
+    arrow_column_t columns[2] = {
+        { "sa", 64, 1, fill_sa_column, sa },
+        { "document", 32, 0, fill_document_column, &documents }
+    };
+
+    if (write_arrow_ipc(output_fn, columns, records != NULL ? 2 : 1, sa_length, metadata, 1) != 0) {
+        perror("Failed to write output file");
+        free(sa);
+        exit(1);
+    }
+
+    if (records != NULL) {
+        size_t records_fn_size = strlen(output_fn) + sizeof(".records.arrow");
+        char* records_fn = malloc(records_fn_size);
+        if (records_fn == NULL) {
+            perror("Failed to allocate memory");
+            free(sa);
+            exit(1);
+        }
+        snprintf(records_fn, records_fn_size, "%s.records.arrow", output_fn);
+
+        arrow_column_t offsets = { "offset", 64, 1, fill_offset_column, records };
+        if (write_arrow_ipc(records_fn, &offsets, 1, records->n_records + 1, NULL, 0) != 0) {
+            perror("Failed to write record offsets");
+            free(records_fn);
+            free(sa);
+            exit(1);
+        }
+        free(records_fn);
+    }
+}
+
+// Function to derive the cache key of an SA from the hash of the input text and the build parameters
+uint64_t sa_cache_key(uint64_t content_hash, int64_t sparseness_factor, int optimized, int both_strands) {
+    // Bump the version whenever the layout or the contents of a built SA change
+    int64_t params[4] = { 3, sparseness_factor, optimized, both_strands };
+    return hash_bytes(params, sizeof(params), content_hash);
+}
+
 int main(int argc, char *argv[]) {
     printf("Command being executed: ");
     for (int i = 0; i < argc; i ++) {
@@ -222,13 +411,15 @@ int main(int argc, char *argv[]) {
     printf("\n");
 
     int opt;
-    int compressed = 0, dna = 0, optimized = 1;
+    int compressed = 0, dna = 0, optimized = 1, arrow = 0, documents = 0, adaptive = 0;
     char *sparseness = NULL;
     char *input_file = NULL;
     char *output_file = NULL;
+    char *cache_dir = NULL;
+    char *ids_file = NULL;
 
     // Parse command-line options
-    while ((opt = getopt(argc, argv, "s:cu")) != -1) {
+    while ((opt = getopt(argc, argv, "s:cuC:admrI:")) != -1) {
         switch (opt) {
             case 's': // Required argument
                 sparseness = optarg;
@@ -239,6 +430,24 @@ int main(int argc, char *argv[]) {
             case 'u':
                 optimized = 0;
                 break;
+            case 'C':
+                cache_dir = optarg;
+                break;
+            case 'a':
+                arrow = 1;
+                break;
+            case 'd':
+                documents = 1;
+                break;
+            case 'm':
+                adaptive = 1;
+                break;
+            case 'r':
+                dna = 1;
+                break;
+            case 'I':
+                ids_file = optarg;
+                break;
             default:
                 print_usage();
                 return EXIT_FAILURE;
@@ -262,30 +471,139 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    if (documents && !arrow) {
+        fprintf(stderr, "Error: Option -d requires -a\n");
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    if (arrow && compressed) {
+        fprintf(stderr, "Error: Options -a and -c cannot be combined\n");
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
     int64_t sparseness_factor = atoi(sparseness);
 
-    clock_t start_reading = clock();
-    printf("Started reading input file from %s ...\n", input_file);
-    size_t length;
-    uint8_t* text = read_text(input_file, &length);
-    printf("Done reading input file in %fs\n", ((double) clock() - start_reading) / CLOCKS_PER_SEC);
-
-    clock_t start_sa = clock();
-    printf("Started building SA...\n");
-    size_t sparseness_factor_size = (size_t)sparseness_factor;
-    size_t sa_length = (length + sparseness_factor_size - 1) / sparseness_factor_size;
-    int64_t* sa;
-    if (optimized > 0) {
-        sa = build_sa_optimized(text, length, sparseness_factor, sa_length, dna);
-    } else {
-        sa = build_sa(text, length, sparseness_factor);
+    size_t sa_length = 0;
+    int64_t* sa = NULL;
+    uint64_t content_hash = 0;
+    int known_content = 0;
+    record_table_t records = { NULL, 0 };
+
+    // An unchanged input file is recognised without reading it, unless only a subset of it is indexed
+    if (cache_dir != NULL && ids_file == NULL && cache_lookup_file_hash(cache_dir, input_file, &content_hash) == 0) {
+        known_content = 1;
+        sa = cache_load_sa(cache_dir, sa_cache_key(content_hash, sparseness_factor, optimized, dna), &sa_length);
+        if (sa != NULL) {
+            TRACE_PROBE1(libsais_packed, cache_hit, sa_length);
+            printf("Reusing cached SA for unchanged input file %s\n", input_file);
+        }
+    }
+
+    if (sa == NULL) {
+        clock_t start_reading = clock();
+        TRACE_PROBE0(libsais_packed, read_start);
+        struct stat input_stat;
+        if (adaptive && stat(input_file, &input_stat) == 0 && wait_for_memory((uint64_t) input_stat.st_size, MAX_MEMORY_PRESSURE, MAX_MEMORY_WAIT) != 0) {
+            printf("Memory is still short after %ds, continuing anyway\n", MAX_MEMORY_WAIT);
+        }
+        printf("Started reading input file from %s ...\n", input_file);
+        size_t length;
+        uint8_t* text;
+        if (ids_file != NULL) {
+            // Without -r, the records are located while gathering them
+            text = read_subset(input_file, ids_file, &length, documents && !dna ? &records : NULL);
+        } else {
+            text = read_text(input_file, &length);
+        }
+        TRACE_PROBE1(libsais_packed, read_done, length);
+        printf("Done reading input file in %fs\n", ((double) clock() - start_reading) / CLOCKS_PER_SEC);
+
+        // The content hash is taken over the input file, so it can be shared by builds with and without -r
+        if (cache_dir != NULL && !known_content) {
+            content_hash = hash_bytes(text, length, 0);
+            if (ids_file == NULL) {
+                cache_store_file_hash(cache_dir, input_file, content_hash);
+            }
+        }
+
+        if (dna) {
+            text = index_both_strands(text, &length);
+        }
+
+        // The text is freed while building the SA, so the records are located first
+        if (documents && records.offsets == NULL && build_record_table(text, length, &records) != 0) {
+            perror("Failed to allocate memory for record table");
+            free(text);
+            exit(1);
+        }
+
+        if (cache_dir != NULL && !known_content) {
+            sa = cache_load_sa(cache_dir, sa_cache_key(content_hash, sparseness_factor, optimized, dna), &sa_length);
+            if (sa != NULL) {
+                TRACE_PROBE1(libsais_packed, cache_hit, sa_length);
+                printf("Reusing cached SA for identical input\n");
+                free(text);
+            }
+        }
+
+        if (sa == NULL) {
+            clock_t start_sa = clock();
+            printf("Started building SA...\n");
+            size_t sparseness_factor_size = (size_t)sparseness_factor;
+            sa_length = (length + sparseness_factor_size - 1) / sparseness_factor_size;
+
+            // The full SA takes k times the memory of the sparse SA, which gives the same result
+            if (adaptive && !optimized) {
+                memory_status_t status;
+                read_memory_status(&status);
+                if (available_memory(&status) < length * sizeof(int64_t)) {
+                    printf("Not enough memory for the full SA, building the sparse SA directly\n");
+                    optimized = 1;
+                }
+            }
+            TRACE_PROBE4(libsais_packed, build_start, length, sparseness_factor, sa_length, optimized);
+            if (optimized > 0) {
+                sa = build_sa_optimized(text, length, sparseness_factor, sa_length, dna, adaptive ? output_file : NULL);
+            } else {
+                sa = build_sa(text, length, sparseness_factor);
+                free(text);
+            }
+            TRACE_PROBE1(libsais_packed, build_done, sa_length);
+            printf("Done building SA in %fs\n", ((double) clock() - start_sa) / CLOCKS_PER_SEC);
+
+            if (cache_dir != NULL && cache_store_sa(cache_dir, sa_cache_key(content_hash, sparseness_factor, optimized, dna), sa, sa_length) != 0) {
+                fprintf(stderr, "Warning: failed to store the SA in cache directory %s\n", cache_dir);
+            }
+        }
+    }
+
+    // A cached SA of an unchanged input file was loaded without reading the text
+    if (documents && records.offsets == NULL) {
+        size_t length;
+        uint8_t* text = read_text(input_file, &length);
+        if (dna) {
+            text = index_both_strands(text, &length);
+        }
+        if (build_record_table(text, length, &records) != 0) {
+            perror("Failed to allocate memory for record table");
+            free(text);
+            exit(1);
+        }
         free(text);
     }
-    printf("Done building SA in %fs\n", ((double) clock() - start_sa) / CLOCKS_PER_SEC);
 
     clock_t start_writing = clock();
+    TRACE_PROBE2(libsais_packed, write_start, sa_length, compressed);
     printf("Started writing results...\n");
-    write_sa(output_file, (uint8_t) sparseness_factor_size, (uint64_t*) sa, sa_length, compressed);
+    if (arrow) {
+        write_sa_arrow(output_file, (uint8_t) sparseness_factor, sa, sa_length, documents ? &records : NULL);
+        free_record_table(&records);
+    } else {
+        write_sa(output_file, (uint8_t) sparseness_factor, (uint64_t*) sa, sa_length, compressed);
+    }
+    TRACE_PROBE1(libsais_packed, write_done, sa_length);
     printf("Done writing results to %s in %fs\n\n", output_file, ((double) clock() - start_writing) / CLOCKS_PER_SEC);
 
     return 0;
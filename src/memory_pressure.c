@@ -0,0 +1,301 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "memory_pressure.h"
+
+// Function to read the number in a file such as memory.max, where "max" means unlimited.
+// Returns -1 if the file does not exist.
+static int read_u64_file(const char* fn, uint64_t* value) {
+    FILE* file = fopen(fn, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char line[64];
+    int result = -1;
+    if (fgets(line, sizeof(line), file) != NULL) {
+        *value = strncmp(line, "max", 3) == 0 ? UINT64_MAX : strtoull(line, NULL, 10);
+        result = 0;
+    }
+    fclose(file);
+    return result;
+}
+
+// Function to read the value of a key from a file of "key value" lines, such as memory.stat or meminfo
+static int read_keyed_u64(const char* fn, const char* key, uint64_t* value) {
+    FILE* file = fopen(fn, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char line[256];
+    size_t key_length = strlen(key);
+    int result = -1;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, key, key_length) == 0 && (line[key_length] == ' ' || line[key_length] == ':')) {
+            *value = strtoull(line + key_length + 1, NULL, 10);
+            result = 0;
+            break;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+// Function to read the avg10 values of a PSI file
+static int read_pressure(const char* fn, double* some, double* full) {
+    FILE* file = fopen(fn, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        double avg10;
+        if (sscanf(line, "some avg10=%lf", &avg10) == 1) {
+            *some = avg10;
+        } else if (sscanf(line, "full avg10=%lf", &avg10) == 1) {
+            *full = avg10;
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+// Function to check whether a comma separated list, such as the controllers of a cgroup, has an item
+static int has_item(const char* list, size_t list_length, const char* item) {
+    size_t item_length = strlen(item);
+    const char* end = list + list_length;
+    while (list < end) {
+        const char* comma = memchr(list, ',', end - list);
+        size_t length = comma != NULL ? (size_t) (comma - list) : (size_t) (end - list);
+        if (length == item_length && strncmp(list, item, length) == 0) {
+            return 1;
+        }
+        list += length + 1;
+    }
+    return 0;
+}
+
+// Function to find the mount point of a cgroup hierarchy in /proc/self/mountinfo: the v1 hierarchy with
+// the `controller`, or the unified (v2) hierarchy if it is NULL. Returns -1 if it is not mounted.
+static int find_cgroup_mount(const char* controller, char* mount, size_t size) {
+    FILE* file = fopen("/proc/self/mountinfo", "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char line[4096];
+    int result = -1;
+    while (result != 0 && fgets(line, sizeof(line), file) != NULL) {
+        // id parent major:minor root mount_point options [optional fields] - type source super_options
+        char point[PATH_MAX];
+        char type[32];
+        char super_options[1024];
+        const char* separator = strstr(line, " - ");
+        if (separator == NULL || sscanf(line, "%*s %*s %*s %*s %4095s", point) != 1
+                || sscanf(separator + 3, "%31s %*s %1023s", type, super_options) != 2) {
+            continue;
+        }
+        int match = controller == NULL ? strcmp(type, "cgroup2") == 0
+            : strcmp(type, "cgroup") == 0 && has_item(super_options, strlen(super_options), controller);
+        if (match && strlen(point) < size) {
+            strcpy(mount, point);
+            result = 0;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+// Function to find the directory of the cgroup of the process in a cgroup hierarchy, from its path in
+// /proc/self/cgroup: the line of the `controller` for v1, or the "0::" line for v2 if it is NULL. Sets
+// the length of the mount point the directory is in, above which its ancestors stop. Returns -1 if the
+// process is not in such a cgroup.
+static int find_cgroup(const char* controller, char* dir, size_t size, size_t* mount_length) {
+    if (find_cgroup_mount(controller, dir, size) != 0) {
+        return -1;
+    }
+    *mount_length = strlen(dir);
+
+    FILE* file = fopen("/proc/self/cgroup", "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    // id:controllers:path
+    char line[4096];
+    int result = -1;
+    while (result != 0 && fgets(line, sizeof(line), file) != NULL) {
+        char* first = strchr(line, ':');
+        char* second = first != NULL ? strchr(first + 1, ':') : NULL;
+        if (second == NULL) {
+            continue;
+        }
+        int match = controller == NULL ? strncmp(line, "0::", 3) == 0
+            : has_item(first + 1, (size_t) (second - first - 1), controller);
+        if (!match) {
+            continue;
+        }
+
+        char* path = second + 1;
+        path[strcspn(path, "\n")] = '\0';
+        // The root cgroup is the mount point itself
+        if (strcmp(path, "/") == 0) {
+            path[0] = '\0';
+        }
+        if (*mount_length + strlen(path) < size) {
+            strcpy(dir + *mount_length, path);
+            result = 0;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+// Function to read the memory limit and usage of the cgroup of the process and its ancestors, the memory
+// available on the system and the memory pressure. Limits of the parents apply to the whole subtree, so
+// the cgroup with the least memory left is taken. The memory hierarchy of cgroup v1 is used if it is
+// mounted, the unified hierarchy of v2 otherwise.
+void read_memory_status(memory_status_t* status) {
+    status->cgroup_limit = UINT64_MAX;
+    status->cgroup_usage = 0;
+    status->system_available = UINT64_MAX;
+    status->pressure_some = -1;
+    status->pressure_full = -1;
+
+    char dir[PATH_MAX];
+    char fn[PATH_MAX + 32];
+    size_t mount_length;
+    int v1 = find_cgroup("memory", dir, sizeof(dir), &mount_length) == 0;
+    if (v1 || find_cgroup(NULL, dir, sizeof(dir), &mount_length) == 0) {
+        uint64_t least_left = UINT64_MAX;
+        while (1) {
+            uint64_t limit, usage = 0, inactive_file = 0;
+            snprintf(fn, sizeof(fn), "%s/%s", dir, v1 ? "memory.limit_in_bytes" : "memory.max");
+            if (read_u64_file(fn, &limit) == 0) {
+                // cgroup v1 has no "max", but a limit close to 2^63
+                if (limit >= (UINT64_MAX >> 2)) {
+                    limit = UINT64_MAX;
+                }
+                snprintf(fn, sizeof(fn), "%s/%s", dir, v1 ? "memory.usage_in_bytes" : "memory.current");
+                read_u64_file(fn, &usage);
+                snprintf(fn, sizeof(fn), "%s/memory.stat", dir);
+                read_keyed_u64(fn, v1 ? "total_inactive_file" : "inactive_file", &inactive_file);
+                usage = usage > inactive_file ? usage - inactive_file : 0;
+
+                uint64_t left = limit > usage ? limit - usage : 0;
+                if (limit != UINT64_MAX && left < least_left) {
+                    least_left = left;
+                    status->cgroup_limit = limit;
+                    status->cgroup_usage = usage;
+                }
+            }
+
+            char* parent = strrchr(dir, '/');
+            if (parent == NULL || (size_t) (parent - dir) < mount_length) {
+                break;
+            }
+            *parent = '\0';
+        }
+    }
+
+    uint64_t available_kb;
+    if (read_keyed_u64("/proc/meminfo", "MemAvailable", &available_kb) == 0) {
+        status->system_available = available_kb * 1024;
+    }
+
+    // The pressure of the cgroup of the process in the unified hierarchy, which has it also when the memory
+    // controller is on v1, or of the whole system otherwise
+    int pressure_read = 0;
+    if (find_cgroup(NULL, dir, sizeof(dir), &mount_length) == 0) {
+        snprintf(fn, sizeof(fn), "%s/memory.pressure", dir);
+        pressure_read = read_pressure(fn, &status->pressure_some, &status->pressure_full) == 0;
+    }
+    if (!pressure_read) {
+        read_pressure("/proc/pressure/memory", &status->pressure_some, &status->pressure_full);
+    }
+}
+
+// Function to compute how many bytes the process can still allocate without exceeding its cgroup limit
+// or pushing the system into reclaim
+uint64_t available_memory(const memory_status_t* status) {
+    uint64_t available = status->system_available;
+    if (status->cgroup_limit != UINT64_MAX) {
+        uint64_t cgroup_available = status->cgroup_limit > status->cgroup_usage ? status->cgroup_limit - status->cgroup_usage : 0;
+        if (cgroup_available < available) {
+            available = cgroup_available;
+        }
+    }
+    return available;
+}
+
+// Function to pause until `required` bytes are available and the full memory pressure is at most
+// `max_pressure` percent. Returns 0 when the memory is there, or -1 after waiting `max_wait_seconds`.
+int wait_for_memory(uint64_t required, double max_pressure, unsigned max_wait_seconds) {
+    unsigned waited = 0;
+    while (1) {
+        memory_status_t status;
+        read_memory_status(&status);
+        uint64_t available = available_memory(&status);
+        if (available >= required && status.pressure_full <= max_pressure) {
+            return 0;
+        }
+        if (waited >= max_wait_seconds) {
+            return -1;
+        }
+
+        if (waited == 0) {
+            printf("Waiting for memory: %llu MiB required, %llu MiB available, pressure %.2f%%\n",
+                (unsigned long long) (required >> 20), (unsigned long long) (available >> 20), status.pressure_full);
+        }
+        sleep(MEMORY_POLL_SECONDS);
+        waited += MEMORY_POLL_SECONDS;
+    }
+}
+
+// Function to move data to a file-backed mapping, whose pages the kernel can write back and drop under
+// memory pressure instead of killing the process. The file is removed right away, so it disappears
+// when the mapping is freed or the process exits. Returns NULL on failure.
+void* spill_to_file(const void* data, size_t size, const char* path_prefix) {
+    size_t path_size = strlen(path_prefix) + sizeof(".spill.XXXXXX");
+    char* path = malloc(path_size);
+    if (path == NULL || size == 0) {
+        free(path);
+        return NULL;
+    }
+    snprintf(path, path_size, "%s.spill.XXXXXX", path_prefix);
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        free(path);
+        return NULL;
+    }
+    unlink(path);
+    free(path);
+
+    const uint8_t* bytes = data;
+    size_t written = 0;
+    while (written < size) {
+        ssize_t n = write(fd, bytes + written, size - written);
+        if (n <= 0) {
+            close(fd);
+            return NULL;
+        }
+        written += (size_t) n;
+    }
+
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+void free_spill(void* map, size_t size) {
+    munmap(map, size);
+}
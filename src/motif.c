@@ -0,0 +1,366 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "motif.h"
+
+#define MOTIF_MAX_REPEAT 1024
+
+#define SET_CONTAINS(set, c) (((set)[(c) >> 6] >> ((c) & 63)) & 1)
+#define SET_ADD(set, c) ((set)[(c) >> 6] |= ((uint64_t) 1) << ((c) & 63))
+#define SET_REMOVE(set, c) ((set)[(c) >> 6] &= ~(((uint64_t) 1) << ((c) & 63)))
+
+typedef struct {
+    uint64_t chars[4];
+    uint32_t min_repeat;
+    uint32_t max_repeat;
+} motif_token_t;
+
+typedef struct {
+    const ssa_index_t* index;
+    const motif_t* motif;
+    size_t offset;
+    motif_hit_callback callback;
+    void* data;
+    size_t hits;
+} motif_search_state_t;
+
+// Function to fill a character set with everything except the record separators
+static void set_all_residues(uint64_t* chars) {
+    memset(chars, 0xFF, 4 * sizeof(uint64_t));
+    for (const char* s = SSA_SEPARATORS; *s; s++) {
+        SET_REMOVE(chars, (uint8_t) *s);
+    }
+}
+
+static int set_count(const uint64_t* set) {
+    int count = 0;
+    for (int i = 0; i < 4; i++) {
+        count += __builtin_popcountll(set[i]);
+    }
+    return count;
+}
+
+static const char* parse_repeat(const char* p, motif_token_t* token) {
+    token->min_repeat = 1;
+    token->max_repeat = 1;
+    if (*p != '(') {
+        return p;
+    }
+
+    char* end;
+    long min_repeat = strtol(p + 1, &end, 10);
+    long max_repeat = min_repeat;
+    if (end == p + 1) {
+        return NULL;
+    }
+    p = end;
+    if (*p == ',') {
+        max_repeat = strtol(p + 1, &end, 10);
+        if (end == p + 1) {
+            return NULL;
+        }
+        p = end;
+    }
+    if (*p != ')' || min_repeat < 0 || max_repeat < min_repeat || max_repeat == 0 || max_repeat > MOTIF_MAX_REPEAT) {
+        return NULL;
+    }
+
+    token->min_repeat = (uint32_t) min_repeat;
+    token->max_repeat = (uint32_t) max_repeat;
+    return p + 1;
+}
+
+// Function to parse a PROSITE-style pattern such as "<M-[ST]-x(2,4)-{P}-[RK]>." into tokens
+static motif_token_t* parse_motif(const char* p, size_t* n_tokens, uint8_t* anchored_start, uint8_t* anchored_end) {
+    size_t capacity = strlen(p) + 1;
+    motif_token_t* tokens = calloc(capacity, sizeof(motif_token_t));
+    if (tokens == NULL) {
+        return NULL;
+    }
+
+    *n_tokens = 0;
+    *anchored_start = 0;
+    *anchored_end = 0;
+    if (*p == '<') {
+        *anchored_start = 1;
+        p++;
+    }
+
+    while (1) {
+        motif_token_t* token = &tokens[*n_tokens];
+        if (*p == 'x') {
+            set_all_residues(token->chars);
+            p++;
+        } else if (*p == '[' || *p == '{') {
+            char close = *p == '[' ? ']' : '}';
+            const char* start = ++p;
+            while (*p >= 'A' && *p <= 'Z') {
+                SET_ADD(token->chars, (uint8_t) *p);
+                p++;
+            }
+            if (*p != close || p == start) {
+                free(tokens);
+                return NULL;
+            }
+            if (close == '}') {
+                uint64_t excluded[4];
+                memcpy(excluded, token->chars, sizeof(excluded));
+                set_all_residues(token->chars);
+                for (int i = 0; i < 4; i++) {
+                    token->chars[i] &= ~excluded[i];
+                }
+            }
+            p++;
+        } else if (*p >= 'A' && *p <= 'Z') {
+            SET_ADD(token->chars, (uint8_t) *p);
+            p++;
+        } else {
+            free(tokens);
+            return NULL;
+        }
+
+        p = parse_repeat(p, token);
+        if (p == NULL) {
+            free(tokens);
+            return NULL;
+        }
+        (*n_tokens)++;
+
+        if (*p == '>') {
+            *anchored_end = 1;
+            p++;
+        }
+        if (*p == '-' && !*anchored_end) {
+            p++;
+        } else if ((*p == '.' && p[1] == '\0') || *p == '\0') {
+            break;
+        } else {
+            free(tokens);
+            return NULL;
+        }
+    }
+
+    return tokens;
+}
+
+// Function to compile a motif against the alphabet of an index. Character classes are expanded into
+// sets of ranks and consecutive fixed characters are merged into literals. Returns -1 on a syntax error.
+int motif_compile(const char* pattern, const ssa_index_t* index, motif_t* motif) {
+    size_t n_tokens;
+    motif_token_t* tokens = parse_motif(pattern, &n_tokens, &motif->anchored_start, &motif->anchored_end);
+    if (tokens == NULL) {
+        return -1;
+    }
+
+    motif->elements = calloc(n_tokens, sizeof(motif_element_t));
+    if (motif->elements == NULL) {
+        free(tokens);
+        return -1;
+    }
+    motif->n_elements = 0;
+    motif->matchable = 1;
+
+    for (size_t t = 0; t < n_tokens; t++) {
+        motif_token_t* token = &tokens[t];
+
+        if (set_count(token->chars) == 1 && token->min_repeat == token->max_repeat) {
+            uint8_t c = 0;
+            while (!SET_CONTAINS(token->chars, c)) {
+                c++;
+            }
+            if (index->rank_to_char[index->char_to_rank[c]] != c) {
+                motif->matchable = 0;
+            }
+
+            // Extend the previous literal or start a new one
+            motif_element_t* element = motif->n_elements > 0 ? &motif->elements[motif->n_elements - 1] : NULL;
+            if (element == NULL || element->literal == NULL) {
+                element = &motif->elements[motif->n_elements++];
+                element->min_repeat = 1;
+                element->max_repeat = 1;
+            }
+            uint8_t* literal = realloc(element->literal, element->literal_len + token->min_repeat);
+            if (literal == NULL) {
+                free(tokens);
+                motif_free(motif);
+                return -1;
+            }
+            memset(literal + element->literal_len, c, token->min_repeat);
+            element->literal = literal;
+            element->literal_len += token->min_repeat;
+            continue;
+        }
+
+        motif_element_t* element = &motif->elements[motif->n_elements++];
+        element->min_repeat = token->min_repeat;
+        element->max_repeat = token->max_repeat;
+        for (uint8_t rank = 0; rank < index->alphabet_size; rank++) {
+            if (SET_CONTAINS(token->chars, index->rank_to_char[rank])) {
+                SET_ADD(element->ranks, rank);
+            }
+        }
+        if (set_count(element->ranks) == 0 && element->min_repeat > 0) {
+            motif->matchable = 0;
+        }
+    }
+
+    free(tokens);
+    return 0;
+}
+
+void motif_free(motif_t* motif) {
+    for (size_t e = 0; e < motif->n_elements; e++) {
+        free(motif->elements[e].literal);
+    }
+    free(motif->elements);
+    motif->elements = NULL;
+    motif->n_elements = 0;
+}
+
+// Function to get the rank of the character at the given depth of the i-th suffix, or -1 past the end of the text
+static int rank_at(const ssa_index_t* index, size_t i, size_t depth) {
+    size_t p = (size_t) ssa_index_get(index, i) + depth;
+    return p < index->text_len ? index->char_to_rank[index->text[p]] : -1;
+}
+
+// Function to find the first suffix in [lo, hi) whose character at the given depth has a rank of at least `rank`
+static size_t lower_bound_rank(const ssa_index_t* index, size_t lo, size_t hi, size_t depth, int rank) {
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (rank_at(index, mid, depth) < rank) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Function to find the first suffix in [lo, hi) whose substring at the given depth compares at least
+// (or, with `strict`, greater than) the literal
+static size_t lower_bound_literal(const ssa_index_t* index, size_t lo, size_t hi, size_t depth, const uint8_t* literal, size_t literal_len, int strict) {
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t p = (size_t) ssa_index_get(index, mid) + depth;
+        size_t available = p < index->text_len ? index->text_len - p : 0;
+        if (available > literal_len) {
+            available = literal_len;
+        }
+        int cmp = packed_compare(index->text + p, available, literal, literal_len, NULL);
+        if (cmp < 0 || (strict && cmp == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int next_rank_in_set(const uint64_t* ranks, int from) {
+    for (int r = from < 0 ? 0 : from; r < 256; r++) {
+        if (SET_CONTAINS(ranks, r)) {
+            return r;
+        }
+    }
+    return -1;
+}
+
+static void report_hits(motif_search_state_t* state, size_t depth, size_t lo, size_t hi) {
+    const ssa_index_t* index = state->index;
+    size_t length = depth - state->offset;
+
+    for (size_t i = lo; i < hi; i++) {
+        size_t position = (size_t) ssa_index_get(index, i) + state->offset;
+        if (state->motif->anchored_start && position > 0 && !ssa_is_separator(index->text[position - 1])) {
+            continue;
+        }
+        if (state->motif->anchored_end && position + length < index->text_len && !ssa_is_separator(index->text[position + length])) {
+            continue;
+        }
+        state->hits++;
+        if (state->callback != NULL) {
+            state->callback((int64_t) position, length, state->data);
+        }
+    }
+}
+
+// Function to walk the SA interval [lo, hi) of suffixes that match the motif up to element e, depth-first
+static void expand_motif(motif_search_state_t* state, size_t e, uint32_t count, size_t depth, size_t lo, size_t hi) {
+    if (lo >= hi) {
+        return;
+    }
+    if (e == state->motif->n_elements) {
+        report_hits(state, depth, lo, hi);
+        return;
+    }
+
+    const ssa_index_t* index = state->index;
+    const motif_element_t* element = &state->motif->elements[e];
+
+    if (element->literal != NULL) {
+        size_t start = lower_bound_literal(index, lo, hi, depth, element->literal, element->literal_len, 0);
+        size_t end = lower_bound_literal(index, start, hi, depth, element->literal, element->literal_len, 1);
+        expand_motif(state, e + 1, 0, depth + element->literal_len, start, end);
+        return;
+    }
+
+    if (count >= element->min_repeat) {
+        expand_motif(state, e + 1, 0, depth, lo, hi);
+    }
+    if (count >= element->max_repeat) {
+        return;
+    }
+
+    // Split the interval on the next character, only visiting ranks that occur and are in the set
+    size_t start = lo;
+    while (start < hi) {
+        int rank = rank_at(index, start, depth);
+        if (rank < 0 || !SET_CONTAINS(element->ranks, rank)) {
+            rank = next_rank_in_set(element->ranks, rank + 1);
+            if (rank < 0) {
+                return;
+            }
+            start = lower_bound_rank(index, start, hi, depth, rank);
+            continue;
+        }
+        size_t end = lower_bound_rank(index, start, hi, depth, rank + 1);
+        expand_motif(state, e, count + 1, depth + 1, start, end);
+        start = end;
+    }
+}
+
+// Function to skip the characters between a sampled suffix and the start of a match
+static void expand_offset(motif_search_state_t* state, size_t remaining, size_t depth, size_t lo, size_t hi) {
+    if (remaining == 0) {
+        expand_motif(state, 0, 0, depth, lo, hi);
+        return;
+    }
+
+    size_t start = lower_bound_rank(state->index, lo, hi, depth, 0);
+    while (start < hi) {
+        int rank = rank_at(state->index, start, depth);
+        size_t end = lower_bound_rank(state->index, start, hi, depth, rank + 1);
+        expand_offset(state, remaining - 1, depth + 1, start, end);
+        start = end;
+    }
+}
+
+// Function to report all occurrences of a compiled motif. In a sparse suffix array only every k-th
+// suffix is present, so a match starting o positions after a sampled suffix is found by first
+// skipping o arbitrary characters, for every offset o < k. Returns the number of hits.
+size_t motif_search(const ssa_index_t* index, const motif_t* motif, motif_hit_callback callback, void* data) {
+    motif_search_state_t state = { index, motif, 0, callback, data, 0 };
+    if (!motif->matchable || index->sa_length == 0) {
+        return 0;
+    }
+
+    size_t sparseness_factor = index->sparseness_factor > 0 ? index->sparseness_factor : 1;
+    for (size_t offset = 0; offset < sparseness_factor; offset++) {
+        state.offset = offset;
+        expand_offset(&state, offset, 0, 0, index->sa_length);
+    }
+
+    return state.hits;
+}
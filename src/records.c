@@ -0,0 +1,56 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "records.h"
+#include "ssa_index.h"
+
+// Function to find the start of every record, where records are separated by a separator character
+int build_record_table(const uint8_t* text, size_t text_len, record_table_t* table) {
+    size_t n_records = text_len > 0 ? 1 : 0;
+    for (size_t i = 0; i + 1 < text_len; i++) {
+        if (ssa_is_separator(text[i])) {
+            n_records++;
+        }
+    }
+
+    table->offsets = malloc((n_records + 1) * sizeof(int64_t));
+    if (table->offsets == NULL) {
+        return -1;
+    }
+    table->n_records = n_records;
+
+    size_t record = 0;
+    if (text_len > 0) {
+        table->offsets[record++] = 0;
+    }
+    for (size_t i = 0; i + 1 < text_len; i++) {
+        if (ssa_is_separator(text[i])) {
+            table->offsets[record++] = (int64_t) i + 1;
+        }
+    }
+    table->offsets[n_records] = (int64_t) text_len;
+
+    return 0;
+}
+
+// Function to find the record that contains a text position
+size_t record_of(const record_table_t* table, int64_t position) {
+    size_t lo = 0, hi = table->n_records;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (table->offsets[mid] <= position) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void free_record_table(record_table_t* table) {
+    free(table->offsets);
+    table->offsets = NULL;
+    table->n_records = 0;
+}
@@ -0,0 +1,164 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "repeats.h"
+
+typedef struct {
+    size_t lcp;
+    size_t lb;
+} lcp_interval_t;
+
+// Function to compute the LCP of two suffixes on the fly, stopping at record separators
+static size_t suffix_lcp(const ssa_index_t* index, size_t p, size_t q) {
+    size_t lcp = packed_lcp(index->text + p, index->text_len - p, index->text + q, index->text_len - q);
+    return ssa_separator_free_length(index->text + p, lcp);
+}
+
+// Function to report every LCP interval with an LCP of at least min_length, in a single streaming pass
+// over the suffix array. LCP values are computed on the fly, so only the stack of open intervals is kept in
+// memory. The count of a repeat is its number of occurrences, so the index must be full: a sparse SA only
+// has the occurrences at sampled positions next to each other. Returns the number of reported repeats, or
+// -1 for a sparse index or when memory runs out.
+int64_t ssa_enumerate_repeats(const ssa_index_t* index, size_t min_length, repeat_callback callback, void* data) {
+    if (index->sparseness_factor > 1) {
+        return -1;
+    }
+    size_t sa_length = index->sa_length;
+    if (sa_length < 2) {
+        return 0;
+    }
+    if (min_length == 0) {
+        min_length = 1;
+    }
+
+    size_t capacity = 64;
+    lcp_interval_t* stack = malloc(capacity * sizeof(lcp_interval_t));
+    if (stack == NULL) {
+        return -1;
+    }
+    size_t top = 0;
+    stack[top++] = (lcp_interval_t) { 0, 0 };
+
+    int64_t repeats = 0;
+    size_t previous = (size_t) ssa_index_get(index, 0);
+    for (size_t i = 1; i <= sa_length; i++) {
+        size_t lcp = 0;
+        if (i < sa_length) {
+            size_t current = (size_t) ssa_index_get(index, i);
+            lcp = suffix_lcp(index, previous, current);
+            previous = current;
+        }
+
+        // Close all intervals that end at i - 1
+        size_t lb = i - 1;
+        while (lcp < stack[top - 1].lcp) {
+            lcp_interval_t interval = stack[--top];
+            if (interval.lcp >= min_length) {
+                repeat_t repeat = { ssa_index_get(index, interval.lb), interval.lcp, i - interval.lb };
+                repeats++;
+                if (callback != NULL) {
+                    callback(&repeat, data);
+                }
+            }
+            lb = interval.lb;
+        }
+
+        if (lcp > stack[top - 1].lcp) {
+            if (top == capacity) {
+                capacity *= 2;
+                lcp_interval_t* resized = realloc(stack, capacity * sizeof(lcp_interval_t));
+                if (resized == NULL) {
+                    free(stack);
+                    return -1;
+                }
+                stack = resized;
+            }
+            stack[top++] = (lcp_interval_t) { lcp, lb };
+        }
+    }
+
+    free(stack);
+    return repeats;
+}
+
+static void heap_sift_down(repeat_t* heap, size_t size, size_t i) {
+    while (1) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < size && heap[left].count < heap[smallest].count) {
+            smallest = left;
+        }
+        if (right < size && heap[right].count < heap[smallest].count) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        repeat_t tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// Function to keep the n most frequent substrings seen so far in a min-heap on their count
+static void heap_offer(repeat_t* heap, size_t* size, size_t n, const repeat_t* repeat) {
+    if (*size < n) {
+        size_t i = (*size)++;
+        heap[i] = *repeat;
+        while (i > 0 && heap[(i - 1) / 2].count > heap[i].count) {
+            repeat_t tmp = heap[i];
+            heap[i] = heap[(i - 1) / 2];
+            heap[(i - 1) / 2] = tmp;
+            i = (i - 1) / 2;
+        }
+    } else if (repeat->count > heap[0].count) {
+        heap[0] = *repeat;
+        heap_sift_down(heap, *size, 0);
+    }
+}
+
+static int compare_count_desc(const void* a, const void* b) {
+    size_t count_a = ((const repeat_t*) a)->count;
+    size_t count_b = ((const repeat_t*) b)->count;
+    return (count_a < count_b) - (count_a > count_b);
+}
+
+// Function to find the n most frequent substrings of exactly the given length. Suffixes that share their
+// first `length` characters are adjacent in the suffix array, so one pass with LCPs capped at `length` and a
+// heap of n entries suffices. As for ssa_enumerate_repeats, the index must be full. The results are written
+// to `top` in decreasing order of count, and the number of results is returned, or -1 for a sparse index.
+int64_t ssa_top_frequent(const ssa_index_t* index, size_t length, size_t n, repeat_t* top) {
+    if (index->sparseness_factor > 1) {
+        return -1;
+    }
+    if (n == 0 || length == 0) {
+        return 0;
+    }
+
+    size_t filled = 0;
+    repeat_t run = { 0, length, 0 };
+    for (size_t i = 0; i < index->sa_length; i++) {
+        size_t p = (size_t) ssa_index_get(index, i);
+        int valid = p + length <= index->text_len && ssa_separator_free_length(index->text + p, length) == length;
+
+        if (run.count > 0 && valid && packed_lcp(index->text + run.position, length, index->text + p, length) == length) {
+            run.count++;
+            continue;
+        }
+        if (run.count > 0) {
+            heap_offer(top, &filled, n, &run);
+        }
+        run.position = (int64_t) p;
+        run.count = valid ? 1 : 0;
+    }
+    if (run.count > 0) {
+        heap_offer(top, &filled, n, &run);
+    }
+
+    qsort(top, filled, sizeof(repeat_t), compare_count_desc);
+    return (int64_t) filled;
+}
@@ -0,0 +1,133 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "search.h"
+
+// Function to compare the suffix at SA[i], cut off at the pattern length, with the pattern. The first
+// `skip` characters are known to match already.
+static int compare_suffix(const ssa_index_t* index, size_t i, const uint8_t* pattern, size_t pattern_len, size_t skip, size_t* lcp) {
+    size_t p = (size_t) ssa_index_get(index, i);
+    size_t available = p < index->text_len ? index->text_len - p : 0;
+    if (available > pattern_len) {
+        available = pattern_len;
+    }
+
+    if (index->trace != NULL) {
+        ssa_trace_read(index->trace, SSA_TRACE_TEXT, index->text + p + skip, available - skip);
+    }
+    int cmp = packed_compare(index->text + p + skip, available - skip, pattern + skip, pattern_len - skip, lcp);
+    *lcp += skip;
+    return cmp;
+}
+
+// Function to find the first suffix in [lo, hi) that is at least (or, with `upper`, greater than) the pattern.
+// With SEARCH_LCP, the LCPs of the pattern with both bounds are tracked and every comparison starts after
+// the smallest of both, since all suffixes in between share at least that prefix with the pattern. All
+// suffixes in [lo, hi) must share the first `known_lcp` characters with the pattern.
+size_t ssa_search_bound(const ssa_index_t* index, size_t lo, size_t hi, const uint8_t* pattern, size_t pattern_len, search_strategy_t strategy, size_t known_lcp, int upper) {
+    size_t lcp_lo = known_lcp;
+    size_t lcp_hi = known_lcp;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t skip = known_lcp;
+        if (strategy == SEARCH_LCP) {
+            skip = lcp_lo < lcp_hi ? lcp_lo : lcp_hi;
+        }
+
+        size_t lcp;
+        int cmp = compare_suffix(index, mid, pattern, pattern_len, skip, &lcp);
+        if (cmp < 0 || (upper && cmp == 0)) {
+            lo = mid + 1;
+            lcp_lo = lcp;
+        } else {
+            hi = mid;
+            lcp_hi = lcp;
+        }
+    }
+    return lo;
+}
+
+// Function to find, for every offset j < k, the SA interval of sampled suffixes that start j characters
+// into a possible occurrence of the pattern. `intervals` must have room for k intervals, their number is
+// returned. Suffixes in an interval with offset j still need their first j characters verified.
+size_t ssa_search_intervals(const ssa_index_t* index, const uint8_t* pattern, size_t pattern_len, search_strategy_t strategy, search_interval_t* intervals) {
+    size_t sparseness_factor = index->sparseness_factor > 0 ? index->sparseness_factor : 1;
+    if (pattern_len == 0) {
+        return 0;
+    }
+
+    for (size_t j = 0; j < sparseness_factor; j++) {
+        // The characters before the sampled suffix, which may be the whole pattern for short patterns
+        size_t prefix_len = j < pattern_len ? j : pattern_len;
+        intervals[j].lower = ssa_search_bound(index, 0, index->sa_length, pattern + prefix_len, pattern_len - prefix_len, strategy, 0, 0);
+        intervals[j].upper = ssa_search_bound(index, intervals[j].lower, index->sa_length, pattern + prefix_len, pattern_len - prefix_len, strategy, 0, 1);
+        intervals[j].offset = j;
+    }
+    return sparseness_factor;
+}
+
+// Function to verify the characters before a sampled suffix found in an interval. Returns 1 and sets the
+// position of the occurrence if they match the pattern.
+int ssa_verify_hit(const ssa_index_t* index, const uint8_t* pattern, size_t pattern_len, const search_interval_t* interval, int64_t suffix, int64_t* position) {
+    size_t s = (size_t) suffix;
+    size_t prefix_len = interval->offset < pattern_len ? interval->offset : pattern_len;
+    if (index->trace != NULL && s >= interval->offset) {
+        ssa_trace_read(index->trace, SSA_TRACE_TEXT, index->text + s - interval->offset, prefix_len);
+    }
+    if (s < interval->offset || memcmp(index->text + s - interval->offset, pattern, prefix_len) != 0) {
+        return 0;
+    }
+    *position = (int64_t) (s - interval->offset);
+    return 1;
+}
+
+// Function to report the occurrences after the last sampled suffix, which have no sampled suffix to be
+// found through. Returns the number of hits.
+size_t ssa_search_tail(const ssa_index_t* index, const uint8_t* pattern, size_t pattern_len, search_hit_callback callback, void* data) {
+    size_t sparseness_factor = index->sparseness_factor > 0 ? index->sparseness_factor : 1;
+    size_t hits = 0;
+    if (pattern_len == 0) {
+        return 0;
+    }
+
+    size_t tail = index->text_len > 0 ? (index->text_len - 1) / sparseness_factor * sparseness_factor + 1 : 0;
+    if (index->trace != NULL && tail < index->text_len) {
+        ssa_trace_read(index->trace, SSA_TRACE_TEXT, index->text + tail, index->text_len - tail);
+    }
+    for (size_t p = tail; p + pattern_len <= index->text_len; p++) {
+        if (memcmp(index->text + p, pattern, pattern_len) == 0) {
+            hits++;
+            if (callback != NULL) {
+                callback((int64_t) p, data);
+            }
+        }
+    }
+    return hits;
+}
+
+// Function to report all occurrences of a pattern. An occurrence at position p is found through the
+// next sampled suffix, p + j, by searching the pattern without its first j characters and then
+// verifying those characters in the text. Patterns shorter than the sparseness factor may end before
+// the next sampled suffix, those are verified against every suffix. Returns the number of hits.
+size_t ssa_search(const ssa_index_t* index, const uint8_t* pattern, size_t pattern_len, search_strategy_t strategy, search_hit_callback callback, void* data) {
+    size_t hits = 0;
+    search_interval_t intervals[SEARCH_MAX_INTERVALS];
+    size_t n_intervals = ssa_search_intervals(index, pattern, pattern_len, strategy, intervals);
+
+    for (size_t j = 0; j < n_intervals; j++) {
+        for (size_t i = intervals[j].lower; i < intervals[j].upper; i++) {
+            int64_t position;
+            if (!ssa_verify_hit(index, pattern, pattern_len, &intervals[j], ssa_index_get(index, i), &position)) {
+                continue;
+            }
+            hits++;
+            if (callback != NULL) {
+                callback(position, data);
+            }
+        }
+    }
+
+    return hits + ssa_search_tail(index, pattern, pattern_len, callback, data);
+}
@@ -0,0 +1,180 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "bitpacking.h"
+#include "ssa_index.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__BYTE_ORDER__)
+    #define HAS_PACKED_LCP
+#endif
+
+// Function to wrap a suffix array and its text, and derive the rank alphabet of the text
+int ssa_index_init(ssa_index_t* index, const uint8_t* text, size_t text_len, const void* sa, size_t sa_length, uint8_t bits_per_element, uint8_t sparseness_factor) {
+    index->text = text;
+    index->text_len = text_len;
+    index->sa = (const uint8_t*) sa;
+    index->sa_length = sa_length;
+    index->bits_per_element = bits_per_element;
+    index->sparseness_factor = sparseness_factor;
+    index->trace = NULL;
+
+    index->char_to_rank = build_char_to_rank(text, text_len, &index->alphabet_size);
+    if (index->char_to_rank == NULL) {
+        return -1;
+    }
+
+    // Every rank except 0 maps back to a single character. Characters that do not occur in
+    // the text also have rank 0, so the first character of the text with rank 0 is the real one.
+    memset(index->rank_to_char, 0, sizeof(index->rank_to_char));
+    for (int c = 0; c < 256; c++) {
+        if (index->char_to_rank[c] != 0) {
+            index->rank_to_char[index->char_to_rank[c]] = (uint8_t) c;
+        }
+    }
+    for (size_t i = 0; i < text_len; i++) {
+        if (index->char_to_rank[text[i]] == 0) {
+            index->rank_to_char[0] = text[i];
+            break;
+        }
+    }
+
+    return 0;
+}
+
+void ssa_index_free(ssa_index_t* index) {
+    free(index->char_to_rank);
+    index->char_to_rank = NULL;
+}
+
+int ssa_is_separator(uint8_t c) {
+    return c != '\0' && strchr(SSA_SEPARATORS, c) != NULL;
+}
+
+// Function to find the length of the prefix of a string that does not contain a record separator
+size_t ssa_separator_free_length(const uint8_t* s, size_t len) {
+    for (const char* sep = SSA_SEPARATORS; *sep; sep++) {
+        const uint8_t* found = memchr(s, *sep, len);
+        if (found != NULL) {
+            len = found - s;
+        }
+    }
+    return len;
+}
+
+// Function to count a read of `length` bytes at `address` in every page it touches, if the address lies in
+// the traced section
+void ssa_trace_read(ssa_page_trace_t* trace, int section, const uint8_t* address, size_t length) {
+    const uint8_t* base = trace->bases[section];
+    if (base == NULL || address < base || (size_t) (address - base) >= trace->sizes[section]) {
+        return;
+    }
+
+    size_t offset = (size_t) (address - base);
+    size_t end = length > trace->sizes[section] - offset ? trace->sizes[section] : offset + length;
+    size_t first = offset / trace->page_size;
+    size_t last = end > offset ? (end - 1) / trace->page_size : first;
+    for (size_t page = first; page <= last; page++) {
+        uint32_t* count = &trace->counts[section][page];
+        uint32_t value = __atomic_load_n(count, __ATOMIC_RELAXED);
+        if (value < UINT32_MAX) {
+            __atomic_store_n(count, value + 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Function to get the i-th suffix of the suffix array, decoding the bitpacked layout if needed
+int64_t ssa_index_get(const ssa_index_t* index, size_t i) {
+    uint64_t word;
+    if (index->bits_per_element == 64) {
+        if (index->trace != NULL) {
+            ssa_trace_read(index->trace, SSA_TRACE_SA, index->sa + i * sizeof(uint64_t), sizeof(uint64_t));
+        }
+        memcpy(&word, index->sa + i * sizeof(uint64_t), sizeof(uint64_t));
+        return (int64_t) word;
+    }
+
+    uint8_t bits = index->bits_per_element;
+    size_t bit_offset = i * bits;
+    size_t word_i = bit_offset / 64;
+    uint8_t shift = bit_offset % 64;
+
+    if (index->trace != NULL) {
+        ssa_trace_read(index->trace, SSA_TRACE_SA, index->sa + word_i * sizeof(uint64_t), (shift + bits > 64 ? 2 : 1) * sizeof(uint64_t));
+    }
+    memcpy(&word, index->sa + word_i * sizeof(uint64_t), sizeof(uint64_t));
+    uint64_t value = (word << shift) >> (64 - bits);
+    if (shift + bits > 64) { // element continues in the next word
+        uint8_t remaining = shift + bits - 64;
+        memcpy(&word, index->sa + (word_i + 1) * sizeof(uint64_t), sizeof(uint64_t));
+        value |= word >> (64 - remaining);
+    }
+    return (int64_t) value;
+}
+
+// Function to bitpack a suffix array in place, using the layout read by ssa_index_get
+void compress_sa(uint64_t* sa, size_t* sa_length, uint8_t bits_per_element) {
+
+    int64_t element = 0;
+    int8_t shift_element = 64 - bits_per_element;
+    size_t compressed_i = 0;
+    for (size_t i = 0; i < *sa_length; i ++) {
+        if (shift_element < 0) { // new element does not fit in element
+            element |= sa[i] >> (-1 * shift_element);
+            sa[compressed_i] = element;
+            compressed_i ++;
+            element = 0;
+            shift_element += 64;
+        }
+        element |= sa[i] << shift_element;
+        shift_element -= bits_per_element;
+    }
+
+    sa[compressed_i] = element;
+
+    *sa_length = compressed_i + 1;
+}
+
+// Function to compute the longest common prefix of two strings, comparing 8 characters at a time
+size_t packed_lcp(const uint8_t* a, size_t a_len, const uint8_t* b, size_t b_len) {
+    size_t len = a_len < b_len ? a_len : b_len;
+    size_t i = 0;
+
+#if defined(HAS_PACKED_LCP)
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t x, y;
+        memcpy(&x, a + i, sizeof(uint64_t));
+        memcpy(&y, b + i, sizeof(uint64_t));
+        uint64_t diff = x ^ y;
+        if (diff != 0) {
+    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return i + (__builtin_ctzll(diff) >> 3);
+    #else
+            return i + (__builtin_clzll(diff) >> 3);
+    #endif
+        }
+    }
+#endif
+
+    while (i < len && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+// Function to lexicographically compare two strings, where a proper prefix is the smallest
+int packed_compare(const uint8_t* a, size_t a_len, const uint8_t* b, size_t b_len, size_t* lcp) {
+    size_t l = packed_lcp(a, a_len, b, b_len);
+    if (lcp != NULL) {
+        *lcp = l;
+    }
+
+    if (l < a_len && l < b_len) {
+        return a[l] < b[l] ? -1 : 1;
+    }
+    if (a_len == b_len) {
+        return 0;
+    }
+    return a_len < b_len ? -1 : 1;
+}
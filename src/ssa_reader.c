@@ -0,0 +1,98 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ssa_reader.h"
+#include "strands.h"
+
+static uint8_t* map_file(const char* fn, size_t* size) {
+    int fd = open(fn, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    *size = (size_t) st.st_size;
+    return (uint8_t*) map;
+}
+
+static int open_index(ssa_reader_t* reader, const char* sa_fn, const char* text_fn, int both_strands) {
+    memset(reader, 0, sizeof(ssa_reader_t));
+
+    reader->sa_map = map_file(sa_fn, &reader->sa_map_size);
+    reader->text_map = map_file(text_fn, &reader->text_map_size);
+    if (reader->sa_map == NULL || reader->text_map == NULL || reader->sa_map_size < SSA_HEADER_SIZE) {
+        ssa_reader_close(reader);
+        return -1;
+    }
+
+    const uint8_t* text = reader->text_map;
+    size_t text_len = reader->text_map_size;
+    if (both_strands) {
+        reader->strands_text = add_reverse_complements(reader->text_map, reader->text_map_size, &text_len);
+        if (reader->strands_text == NULL) {
+            ssa_reader_close(reader);
+            return -1;
+        }
+        text = reader->strands_text;
+    }
+
+    uint8_t bits_per_element = reader->sa_map[0];
+    uint8_t sparseness_factor = reader->sa_map[1];
+    uint64_t sa_length;
+    memcpy(&sa_length, reader->sa_map + 2, sizeof(uint64_t));
+
+    size_t payload_words = bits_per_element == 64 ? sa_length : (sa_length * bits_per_element + 63) / 64;
+    if (bits_per_element == 0 || bits_per_element > 64 || sparseness_factor == 0
+            || reader->sa_map_size - SSA_HEADER_SIZE < payload_words * sizeof(uint64_t)) {
+        ssa_reader_close(reader);
+        return -1;
+    }
+
+    if (ssa_index_init(&reader->index, text, text_len, reader->sa_map + SSA_HEADER_SIZE,
+            sa_length, bits_per_element, sparseness_factor) != 0) {
+        ssa_reader_close(reader);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to open an SA file and its text without copying them. Returns -1 if a file cannot be mapped
+// or the SA file is malformed.
+int ssa_reader_open(ssa_reader_t* reader, const char* sa_fn, const char* text_fn) {
+    return open_index(reader, sa_fn, text_fn, 0);
+}
+
+// Function to open an SA file built with -r on both strands of its text. The text with the reverse
+// complements is rebuilt in memory, the SA file is still mapped.
+int ssa_reader_open_strands(ssa_reader_t* reader, const char* sa_fn, const char* text_fn) {
+    return open_index(reader, sa_fn, text_fn, 1);
+}
+
+void ssa_reader_close(ssa_reader_t* reader) {
+    ssa_index_free(&reader->index);
+    if (reader->sa_map != NULL) {
+        munmap(reader->sa_map, reader->sa_map_size);
+    }
+    if (reader->text_map != NULL) {
+        munmap(reader->text_map, reader->text_map_size);
+    }
+    free(reader->strands_text);
+    memset(reader, 0, sizeof(ssa_reader_t));
+}
@@ -0,0 +1,774 @@
+
+// O_DIRECT
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "search.h"
+#include "ssa_reader.h"
+#include "ssd_index.h"
+
+#define SSD_TIER_MAGIC "SSATIER"
+#define SSD_FILE_SA 0
+#define SSD_FILE_TEXT 1
+#define EMPTY_KEY UINT64_MAX
+#define NO_SLOT (-1)
+
+// A sampled suffix compares as smaller, equal or greater than a pattern, or its prefix is not long enough to tell
+#define SAMPLE_UNKNOWN 2
+
+typedef enum {
+    QUERY_INTERVAL,
+    QUERY_LOWER,
+    QUERY_UPPER,
+    QUERY_HITS,
+    QUERY_TAIL,
+    QUERY_DONE
+} query_phase_t;
+
+// The progress of a query through ssa_search, kept so it can stop at any block that is not cached and
+// continue where it left off once the block is read. The suffix and the characters that are loaded are
+// copied out of the cache, so a block is only needed until the query has read it once.
+typedef struct {
+    size_t id;
+    const uint8_t* pattern;
+    size_t pattern_len;
+    query_phase_t phase;
+    size_t offset;
+    size_t known_lcp;
+    size_t range_lower;
+    size_t range_upper;
+    size_t lo;
+    size_t hi;
+    size_t lcp_lo;
+    size_t lcp_hi;
+    size_t lower;
+    size_t upper;
+    size_t i;
+    int has_suffix;
+    int64_t suffix;
+    size_t loaded;
+    uint8_t sa_bytes[2 * sizeof(uint64_t)];
+    uint8_t* buffer;
+    size_t hits;
+    uint64_t wanted;
+} ssd_query_t;
+
+static int has_rank(const ssd_tier_t* tier, uint8_t c) {
+    return tier->char_to_rank[c] != 0 || (tier->alphabet_size > 0 && c == tier->rank_to_char[0]);
+}
+
+// Function to build the RAM tier of an index, reading the SA and text once. Returns -1 if memory runs out.
+int ssd_tier_build(ssd_tier_t* tier, const ssa_index_t* index, size_t sample_rate) {
+    memset(tier, 0, sizeof(ssd_tier_t));
+    tier->bits_per_element = index->bits_per_element;
+    tier->sparseness_factor = index->sparseness_factor;
+    tier->sa_length = index->sa_length;
+    tier->text_len = index->text_len;
+    memcpy(tier->char_to_rank, index->char_to_rank, sizeof(tier->char_to_rank));
+    memcpy(tier->rank_to_char, index->rank_to_char, sizeof(tier->rank_to_char));
+    tier->alphabet_size = index->alphabet_size;
+
+    tier->sample_rate = sample_rate > 0 ? sample_rate : SSD_DEFAULT_SAMPLE_RATE;
+    tier->n_samples = (index->sa_length + tier->sample_rate - 1) / tier->sample_rate;
+    tier->sample_prefixes = malloc(tier->n_samples * SSD_SAMPLE_PREFIX + 1);
+    tier->sample_lengths = malloc(tier->n_samples + 1);
+    if (tier->sample_prefixes == NULL || tier->sample_lengths == NULL || bucket_table_build(index, &tier->buckets) != 0) {
+        ssd_tier_free(tier);
+        return -1;
+    }
+
+    for (size_t s = 0; s < tier->n_samples; s++) {
+        size_t p = (size_t) ssa_index_get(index, s * tier->sample_rate);
+        size_t suffix_len = p < index->text_len ? index->text_len - p : 0;
+        size_t stored = suffix_len < SSD_SAMPLE_PREFIX ? suffix_len : SSD_SAMPLE_PREFIX;
+        memcpy(tier->sample_prefixes + s * SSD_SAMPLE_PREFIX, index->text + p, stored);
+        tier->sample_lengths[s] = (uint8_t) (suffix_len < SSD_SAMPLE_PREFIX + 1 ? suffix_len : SSD_SAMPLE_PREFIX + 1);
+    }
+    return 0;
+}
+
+static int write_u64(FILE* file, uint64_t value) {
+    return fwrite(&value, sizeof(uint64_t), 1, file) == 1 ? 0 : -1;
+}
+
+static int read_u64(FILE* file, uint64_t* value) {
+    return fread(value, sizeof(uint64_t), 1, file) == 1 ? 0 : -1;
+}
+
+static int write_sizes(FILE* file, const size_t* values, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (write_u64(file, (uint64_t) values[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to read `n` values written by write_sizes, that must all be at most `max`
+static int read_sizes(FILE* file, size_t* values, size_t n, uint64_t max) {
+    for (size_t i = 0; i < n; i++) {
+        uint64_t value;
+        if (read_u64(file, &value) != 0 || value > max) {
+            return -1;
+        }
+        values[i] = (size_t) value;
+    }
+    return 0;
+}
+
+// Function to write a tier to a file, so a query node does not need to read the whole index to build it
+int ssd_tier_write(const ssd_tier_t* tier, const char* output_fn) {
+    FILE* file = fopen(output_fn, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    const bucket_table_t* buckets = &tier->buckets;
+    uint8_t header[3] = { tier->bits_per_element, tier->sparseness_factor, tier->alphabet_size };
+    int failed = fwrite(SSD_TIER_MAGIC, 1, sizeof(SSD_TIER_MAGIC), file) != sizeof(SSD_TIER_MAGIC)
+        || fwrite(header, 1, sizeof(header), file) != sizeof(header)
+        || write_u64(file, tier->sa_length) != 0 || write_u64(file, tier->text_len) != 0
+        || fwrite(tier->char_to_rank, 1, 256, file) != 256 || fwrite(tier->rank_to_char, 1, 256, file) != 256
+        || write_u64(file, buckets->q) != 0 || write_u64(file, buckets->alphabet_size) != 0
+        || write_u64(file, buckets->n_buckets) != 0 || write_u64(file, buckets->n_short) != 0
+        || write_sizes(file, buckets->starts, buckets->n_buckets + 1) != 0
+        || write_sizes(file, buckets->short_suffixes, buckets->n_short) != 0
+        || fwrite(buckets->short_texts, 1, buckets->n_short * buckets->q, file) != buckets->n_short * buckets->q
+        || write_u64(file, SSD_SAMPLE_PREFIX) != 0 || write_u64(file, tier->sample_rate) != 0
+        || fwrite(tier->sample_prefixes, SSD_SAMPLE_PREFIX, tier->n_samples, file) != tier->n_samples
+        || fwrite(tier->sample_lengths, 1, tier->n_samples, file) != tier->n_samples;
+
+    if (fclose(file) != 0) {
+        failed = 1;
+    }
+    return failed ? -1 : 0;
+}
+
+// Function to load a tier written by ssd_tier_write. Returns -1 if the file cannot be read or is malformed.
+int ssd_tier_load(ssd_tier_t* tier, const char* input_fn) {
+    memset(tier, 0, sizeof(ssd_tier_t));
+    FILE* file = fopen(input_fn, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    bucket_table_t* buckets = &tier->buckets;
+    char magic[sizeof(SSD_TIER_MAGIC)];
+    uint8_t header[3];
+    uint64_t sa_length, text_len, q, alphabet_size, n_buckets, n_short, prefix_len, sample_rate;
+    int failed = fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+        || memcmp(magic, SSD_TIER_MAGIC, sizeof(magic)) != 0
+        || fread(header, 1, sizeof(header), file) != sizeof(header)
+        || read_u64(file, &sa_length) != 0 || read_u64(file, &text_len) != 0
+        || fread(tier->char_to_rank, 1, 256, file) != 256 || fread(tier->rank_to_char, 1, 256, file) != 256
+        || read_u64(file, &q) != 0 || read_u64(file, &alphabet_size) != 0
+        || read_u64(file, &n_buckets) != 0 || read_u64(file, &n_short) != 0
+        || q == 0 || q > 64 || n_short > q || alphabet_size == 0 || alphabet_size > 256
+        || n_buckets == 0 || n_buckets > BUCKET_TABLE_MAX_BUCKETS || sa_length > text_len;
+
+    if (!failed) {
+        tier->bits_per_element = header[0];
+        tier->sparseness_factor = header[1];
+        tier->alphabet_size = header[2];
+        tier->sa_length = (size_t) sa_length;
+        tier->text_len = (size_t) text_len;
+        buckets->q = (size_t) q;
+        buckets->alphabet_size = (size_t) alphabet_size;
+        buckets->n_buckets = (size_t) n_buckets;
+        buckets->n_short = (size_t) n_short;
+        buckets->text_len = (size_t) text_len;
+        buckets->starts = malloc((buckets->n_buckets + 1) * sizeof(size_t));
+        buckets->short_suffixes = malloc(buckets->q * sizeof(size_t));
+        buckets->short_texts = malloc(buckets->q * buckets->q);
+        failed = buckets->starts == NULL || buckets->short_suffixes == NULL || buckets->short_texts == NULL
+            || read_sizes(file, buckets->starts, buckets->n_buckets + 1, sa_length) != 0
+            || read_sizes(file, buckets->short_suffixes, buckets->n_short, text_len - 1) != 0
+            || fread(buckets->short_texts, 1, buckets->n_short * buckets->q, file) != buckets->n_short * buckets->q
+            || read_u64(file, &prefix_len) != 0 || prefix_len != SSD_SAMPLE_PREFIX
+            || read_u64(file, &sample_rate) != 0 || sample_rate == 0;
+    }
+
+    // Keys of q-grams must stay within the buckets
+    uint64_t n_keys = 1;
+    for (size_t t = 0; t < buckets->q && !failed; t++) {
+        n_keys *= alphabet_size;
+        failed = n_keys > n_buckets;
+    }
+    for (int c = 0; c < 256 && !failed; c++) {
+        failed = n_keys != n_buckets || tier->char_to_rank[c] >= alphabet_size;
+    }
+
+    if (!failed) {
+        tier->sample_rate = (size_t) sample_rate;
+        tier->n_samples = (tier->sa_length + tier->sample_rate - 1) / tier->sample_rate;
+        tier->sample_prefixes = malloc(tier->n_samples * SSD_SAMPLE_PREFIX + 1);
+        tier->sample_lengths = malloc(tier->n_samples + 1);
+        failed = tier->sample_prefixes == NULL || tier->sample_lengths == NULL
+            || fread(tier->sample_prefixes, SSD_SAMPLE_PREFIX, tier->n_samples, file) != tier->n_samples
+            || fread(tier->sample_lengths, 1, tier->n_samples, file) != tier->n_samples;
+    }
+
+    fclose(file);
+    if (failed) {
+        ssd_tier_free(tier);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to compute the RAM a tier takes, in bytes
+size_t ssd_tier_size(const ssd_tier_t* tier) {
+    const bucket_table_t* buckets = &tier->buckets;
+    return sizeof(ssd_tier_t) + (buckets->n_buckets + 1) * sizeof(size_t)
+        + buckets->q * (sizeof(size_t) + buckets->q) + tier->n_samples * (SSD_SAMPLE_PREFIX + 1);
+}
+
+void ssd_tier_free(ssd_tier_t* tier) {
+    bucket_table_free(&tier->buckets);
+    free(tier->sample_prefixes);
+    free(tier->sample_lengths);
+    memset(tier, 0, sizeof(ssd_tier_t));
+}
+
+// Function to compare a sampled suffix, cut off at the pattern length, with the pattern as far as the
+// sampled prefix tells
+static int compare_sample(const ssd_tier_t* tier, size_t s, const uint8_t* pattern, size_t pattern_len) {
+    const uint8_t* prefix = tier->sample_prefixes + s * SSD_SAMPLE_PREFIX;
+    size_t stored = tier->sample_lengths[s] < SSD_SAMPLE_PREFIX ? tier->sample_lengths[s] : SSD_SAMPLE_PREFIX;
+    size_t compared = stored < pattern_len ? stored : pattern_len;
+
+    size_t lcp = packed_lcp(prefix, compared, pattern, compared);
+    if (lcp < compared) {
+        return prefix[lcp] < pattern[lcp] ? -1 : 1;
+    }
+    if (compared == pattern_len) {
+        return 0;
+    }
+    // The suffix is a proper prefix of the pattern, unless it continues after the sampled prefix
+    return tier->sample_lengths[s] > SSD_SAMPLE_PREFIX ? SAMPLE_UNKNOWN : -1;
+}
+
+// Function to narrow the range [lo, hi) in which the search for the first suffix at least (or, with
+// `upper`, greater than) the pattern ends, with the samples in that range. The samples that are known
+// to come before the bound and those known to come after it sandwich the bound between two samples.
+static void narrow_with_samples(const ssd_tier_t* tier, const uint8_t* pattern, size_t pattern_len, int upper, size_t* lo, size_t* hi) {
+    size_t rate = tier->sample_rate;
+    size_t first = (*lo + rate - 1) / rate;
+    size_t end = (*hi + rate - 1) / rate;
+
+    // First sample not known to be before the bound
+    size_t a = first, b = end;
+    while (a < b) {
+        size_t mid = a + (b - a) / 2;
+        int cmp = compare_sample(tier, mid, pattern, pattern_len);
+        if (cmp == -1 || (upper && cmp == 0)) {
+            a = mid + 1;
+        } else {
+            b = mid;
+        }
+    }
+    size_t after = a;
+
+    // First sample known to be at or after the bound
+    b = end;
+    while (a < b) {
+        size_t mid = a + (b - a) / 2;
+        int cmp = compare_sample(tier, mid, pattern, pattern_len);
+        if (cmp == SAMPLE_UNKNOWN || (upper && cmp == 0)) {
+            a = mid + 1;
+        } else {
+            b = mid;
+        }
+    }
+
+    if (after > first) {
+        *lo = (after - 1) * rate + 1;
+    }
+    if (a < end) {
+        *hi = a * rate;
+    }
+}
+
+static int open_block_file(const char* fn, size_t* size) {
+    // Without O_DIRECT on file systems that do not support it
+    int fd = open(fn, O_RDONLY | O_DIRECT);
+    if (fd < 0 && errno == EINVAL) {
+        fd = open(fn, O_RDONLY);
+    }
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (fd >= 0) {
+        *size = (size_t) st.st_size;
+    }
+    return fd;
+}
+
+static uint64_t block_key(int file, uint64_t block) {
+    return ((uint64_t) file << 63) | block;
+}
+
+static size_t key_head(const block_cache_t* cache, uint64_t key) {
+    return (size_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & (cache->n_heads - 1);
+}
+
+static int32_t cache_find(const block_cache_t* cache, uint64_t key) {
+    for (int32_t slot = cache->heads[key_head(cache, key)]; slot != NO_SLOT; slot = cache->next[slot]) {
+        if (cache->keys[slot] == key) {
+            return slot;
+        }
+    }
+    return NO_SLOT;
+}
+
+// Function to free a slot for a block of round `round` with the clock algorithm. Returns NO_SLOT if every
+// slot holds a block of this round.
+static int32_t cache_claim(block_cache_t* cache, uint64_t round) {
+    for (size_t tries = 0; tries < 2 * cache->n_slots + 1; tries++) {
+        size_t slot = cache->hand;
+        cache->hand = (cache->hand + 1) % cache->n_slots;
+        if (cache->rounds[slot] == round) {
+            continue;
+        }
+        if (cache->keys[slot] != EMPTY_KEY && cache->referenced[slot]) {
+            cache->referenced[slot] = 0;
+            continue;
+        }
+
+        // The slot belongs to this round from now on, even before its block is read
+        cache->rounds[slot] = round;
+        if (cache->keys[slot] != EMPTY_KEY) {
+            int32_t* link = &cache->heads[key_head(cache, cache->keys[slot])];
+            while (*link != (int32_t) slot) {
+                link = &cache->next[*link];
+            }
+            *link = cache->next[slot];
+            cache->keys[slot] = EMPTY_KEY;
+        }
+        return (int32_t) slot;
+    }
+    return NO_SLOT;
+}
+
+static void cache_insert(block_cache_t* cache, int32_t slot, uint64_t key, size_t length, uint64_t round) {
+    size_t head = key_head(cache, key);
+    cache->keys[slot] = key;
+    cache->lengths[slot] = length;
+    cache->rounds[slot] = round;
+    cache->referenced[slot] = 1;
+    cache->next[slot] = cache->heads[head];
+    cache->heads[head] = slot;
+}
+
+static void free_cache(block_cache_t* cache) {
+    free(cache->blocks);
+    free(cache->keys);
+    free(cache->lengths);
+    free(cache->rounds);
+    free(cache->referenced);
+    free(cache->next);
+    free(cache->heads);
+    memset(cache, 0, sizeof(block_cache_t));
+}
+
+static int alloc_cache(block_cache_t* cache, size_t n_slots) {
+    memset(cache, 0, sizeof(block_cache_t));
+    cache->n_slots = n_slots;
+    cache->n_heads = 1;
+    while (cache->n_heads < 2 * n_slots) {
+        cache->n_heads *= 2;
+    }
+
+    void* blocks = NULL;
+    if (posix_memalign(&blocks, SSD_BLOCK_SIZE, n_slots * SSD_BLOCK_SIZE) != 0) {
+        blocks = NULL;
+    }
+    cache->blocks = blocks;
+    cache->keys = malloc(n_slots * sizeof(uint64_t));
+    cache->lengths = malloc(n_slots * sizeof(size_t));
+    cache->rounds = calloc(n_slots, sizeof(uint64_t));
+    cache->referenced = calloc(n_slots, 1);
+    cache->next = malloc(n_slots * sizeof(int32_t));
+    cache->heads = malloc(cache->n_heads * sizeof(int32_t));
+    if (cache->blocks == NULL || cache->keys == NULL || cache->lengths == NULL || cache->rounds == NULL
+            || cache->referenced == NULL || cache->next == NULL || cache->heads == NULL) {
+        free_cache(cache);
+        return -1;
+    }
+
+    for (size_t slot = 0; slot < n_slots; slot++) {
+        cache->keys[slot] = EMPTY_KEY;
+        cache->next[slot] = NO_SLOT;
+    }
+    for (size_t head = 0; head < cache->n_heads; head++) {
+        cache->heads[head] = NO_SLOT;
+    }
+    return 0;
+}
+
+// Function to open an SA file and its text for queries through a tier built on them, with a block cache
+// of `cache_blocks` blocks of SSD_BLOCK_SIZE bytes. A query reads some blocks more than once, so the cache
+// needs a few dozen blocks per query of a batch, or the queries of a batch evict each other's blocks.
+// Returns -1 if a file cannot be opened or does not match the tier, or memory runs out.
+int ssd_index_open(ssd_index_t* ssd, const ssd_tier_t* tier, const char* sa_fn, const char* text_fn, size_t cache_blocks) {
+    memset(ssd, 0, sizeof(ssd_index_t));
+    ssd->tier = tier;
+    ssd->sa_fd = open_block_file(sa_fn, &ssd->sa_file_size);
+    ssd->text_fd = open_block_file(text_fn, &ssd->text_file_size);
+    block_io_init(&ssd->io);
+    if (ssd->sa_fd < 0 || ssd->text_fd < 0 || ssd->sa_file_size < SSA_HEADER_SIZE
+            || alloc_cache(&ssd->cache, cache_blocks > 0 ? cache_blocks : 1) != 0) {
+        ssd_index_close(ssd);
+        return -1;
+    }
+
+    // The header is read through the cache, as the files may need aligned reads
+    block_read_t header_read = { ssd->sa_fd, 0, SSD_BLOCK_SIZE, ssd->cache.blocks, 0 };
+    block_io_read(&ssd->io, &header_read, 1);
+    uint64_t sa_length = 0;
+    memcpy(&sa_length, ssd->cache.blocks + 2, sizeof(uint64_t));
+    size_t payload_words = tier->bits_per_element == 64 ? tier->sa_length : (tier->sa_length * tier->bits_per_element + 63) / 64;
+    if (header_read.result < (ssize_t) SSA_HEADER_SIZE || ssd->cache.blocks[0] != tier->bits_per_element
+            || ssd->cache.blocks[1] != tier->sparseness_factor || sa_length != tier->sa_length
+            || ssd->sa_file_size - SSA_HEADER_SIZE < payload_words * sizeof(uint64_t)
+            || ssd->text_file_size != tier->text_len) {
+        ssd_index_close(ssd);
+        return -1;
+    }
+    return 0;
+}
+
+void ssd_index_close(ssd_index_t* ssd) {
+    if (ssd->sa_fd >= 0) {
+        close(ssd->sa_fd);
+    }
+    if (ssd->text_fd >= 0) {
+        close(ssd->text_fd);
+    }
+    block_io_free(&ssd->io);
+    free_cache(&ssd->cache);
+    memset(ssd, 0, sizeof(ssd_index_t));
+    ssd->sa_fd = -1;
+    ssd->text_fd = -1;
+}
+
+// Function to copy `length` bytes at `offset` of a file out of the cache. When a block is not cached, it
+// is set as the block the query waits for and 0 is returned, the next call continues with that block.
+static int load_range(ssd_index_t* ssd, ssd_query_t* query, int file, uint64_t offset, size_t length, uint8_t* out) {
+    block_cache_t* cache = &ssd->cache;
+    while (query->loaded < length) {
+        uint64_t position = offset + query->loaded;
+        uint64_t key = block_key(file, position / SSD_BLOCK_SIZE);
+        int32_t slot = cache_find(cache, key);
+        size_t in_block = position % SSD_BLOCK_SIZE;
+        if (slot == NO_SLOT || cache->lengths[slot] <= in_block) {
+            query->wanted = key;
+            return 0;
+        }
+
+        size_t n = cache->lengths[slot] - in_block;
+        if (n > length - query->loaded) {
+            n = length - query->loaded;
+        }
+        memcpy(out + query->loaded, cache->blocks + (size_t) slot * SSD_BLOCK_SIZE + in_block, n);
+        query->loaded += n;
+        cache->referenced[slot] = 1;
+        ssd->cache_hits++;
+    }
+    query->loaded = 0;
+    return 1;
+}
+
+// Function to load SA[i] into the query, decoding the bitpacked layout as ssa_index_get does
+static int load_suffix(ssd_index_t* ssd, ssd_query_t* query, size_t i) {
+    if (query->has_suffix) {
+        return 1;
+    }
+
+    uint8_t bits = ssd->tier->bits_per_element;
+    size_t bit_offset = bits == 64 ? i * 64 : i * bits;
+    size_t word_i = bit_offset / 64;
+    uint8_t shift = bit_offset % 64;
+    size_t length = shift + bits > 64 ? 2 * sizeof(uint64_t) : sizeof(uint64_t);
+    if (!load_range(ssd, query, SSD_FILE_SA, SSA_HEADER_SIZE + word_i * sizeof(uint64_t), length, query->sa_bytes)) {
+        return 0;
+    }
+
+    uint64_t word;
+    memcpy(&word, query->sa_bytes, sizeof(uint64_t));
+    uint64_t value = bits == 64 ? word : (word << shift) >> (64 - bits);
+    if (shift + bits > 64) {
+        uint8_t remaining = shift + bits - 64;
+        memcpy(&word, query->sa_bytes + sizeof(uint64_t), sizeof(uint64_t));
+        value |= word >> (64 - remaining);
+    }
+    query->suffix = (int64_t) value;
+    query->has_suffix = 1;
+    return 1;
+}
+
+// Function to start the search of the interval with the current offset: the bucket of the first q
+// characters of the pattern without its first `offset` characters is looked up, and narrowed with the samples
+static void start_interval(const ssd_tier_t* tier, ssd_query_t* query) {
+    size_t prefix_len = query->offset < query->pattern_len ? query->offset : query->pattern_len;
+    const uint8_t* pattern = query->pattern + prefix_len;
+    size_t pattern_len = query->pattern_len - prefix_len;
+    const bucket_table_t* buckets = &tier->buckets;
+
+    size_t key_len = pattern_len < buckets->q ? pattern_len : buckets->q;
+    size_t key = 0;
+    int valid = 1;
+    for (size_t t = 0; t < key_len; t++) {
+        valid &= has_rank(tier, pattern[t]);
+        key = key * buckets->alphabet_size + tier->char_to_rank[pattern[t]];
+    }
+
+    search_interval_t range = { 0, 0, 0 };
+    if (valid) {
+        bucket_table_interval(buckets, key, pattern, key_len, &range);
+    }
+    query->range_lower = range.lower;
+    query->range_upper = range.upper;
+    query->known_lcp = key_len;
+    query->lo = range.lower;
+    query->hi = range.upper;
+    query->lcp_lo = query->lcp_hi = key_len;
+    narrow_with_samples(tier, pattern, pattern_len, 0, &query->lo, &query->hi);
+    query->phase = QUERY_LOWER;
+}
+
+// Function to run a query until it needs a block that is not cached, in which case 1 is returned, or
+// until it is done. Hits are found in the same order as ssa_search finds them.
+static int step_query(ssd_index_t* ssd, ssd_query_t* query, ssd_hit_callback callback, void* data) {
+    const ssd_tier_t* tier = ssd->tier;
+    size_t sparseness_factor = tier->sparseness_factor > 0 ? tier->sparseness_factor : 1;
+
+    for (;;) {
+        size_t prefix_len = query->offset < query->pattern_len ? query->offset : query->pattern_len;
+        const uint8_t* pattern = query->pattern + prefix_len;
+        size_t pattern_len = query->pattern_len - prefix_len;
+
+        switch (query->phase) {
+            case QUERY_INTERVAL:
+                if (query->offset == sparseness_factor) {
+                    query->phase = QUERY_TAIL;
+                } else {
+                    start_interval(tier, query);
+                }
+                break;
+
+            case QUERY_LOWER:
+            case QUERY_UPPER:
+                if (query->lo < query->hi) {
+                    // One step of ssa_search_bound with SEARCH_LCP
+                    size_t mid = query->lo + (query->hi - query->lo) / 2;
+                    size_t skip = query->lcp_lo < query->lcp_hi ? query->lcp_lo : query->lcp_hi;
+                    if (!load_suffix(ssd, query, mid)) {
+                        return 1;
+                    }
+                    size_t p = (size_t) query->suffix;
+                    size_t available = p < tier->text_len ? tier->text_len - p : 0;
+                    if (available > pattern_len) {
+                        available = pattern_len;
+                    }
+                    if (available > skip && !load_range(ssd, query, SSD_FILE_TEXT, p + skip, available - skip, query->buffer)) {
+                        return 1;
+                    }
+                    query->has_suffix = 0;
+
+                    size_t lcp;
+                    int cmp = packed_compare(query->buffer, available - skip, pattern + skip, pattern_len - skip, &lcp);
+                    lcp += skip;
+                    if (cmp < 0 || (query->phase == QUERY_UPPER && cmp == 0)) {
+                        query->lo = mid + 1;
+                        query->lcp_lo = lcp;
+                    } else {
+                        query->hi = mid;
+                        query->lcp_hi = lcp;
+                    }
+                } else if (query->phase == QUERY_LOWER) {
+                    query->lower = query->lo;
+                    query->hi = query->range_upper;
+                    query->lcp_lo = query->lcp_hi = query->known_lcp;
+                    narrow_with_samples(tier, pattern, pattern_len, 1, &query->lo, &query->hi);
+                    if (query->lo < query->lower) {
+                        query->lo = query->lower;
+                    }
+                    query->phase = QUERY_UPPER;
+                } else {
+                    query->upper = query->lo;
+                    query->i = query->lower;
+                    query->phase = QUERY_HITS;
+                }
+                break;
+
+            case QUERY_HITS:
+                if (query->i < query->upper) {
+                    // ssa_verify_hit on the characters before the sampled suffix
+                    if (!load_suffix(ssd, query, query->i)) {
+                        return 1;
+                    }
+                    size_t s = (size_t) query->suffix;
+                    if (s >= query->offset && prefix_len > 0
+                            && !load_range(ssd, query, SSD_FILE_TEXT, s - query->offset, prefix_len, query->buffer)) {
+                        return 1;
+                    }
+                    query->has_suffix = 0;
+                    query->i++;
+                    if (s >= query->offset && memcmp(query->buffer, query->pattern, prefix_len) == 0) {
+                        query->hits++;
+                        if (callback != NULL) {
+                            callback(query->id, (int64_t) (s - query->offset), data);
+                        }
+                    }
+                } else {
+                    query->offset++;
+                    query->phase = QUERY_INTERVAL;
+                }
+                break;
+
+            case QUERY_TAIL: {
+                // ssa_search_tail on the at most k - 1 characters after the last sampled suffix
+                size_t tail = tier->text_len > 0 ? (tier->text_len - 1) / sparseness_factor * sparseness_factor + 1 : 0;
+                if (tail + query->pattern_len <= tier->text_len) {
+                    if (!load_range(ssd, query, SSD_FILE_TEXT, tail, tier->text_len - tail, query->buffer)) {
+                        return 1;
+                    }
+                    for (size_t p = tail; p + query->pattern_len <= tier->text_len; p++) {
+                        if (memcmp(query->buffer + (p - tail), query->pattern, query->pattern_len) == 0) {
+                            query->hits++;
+                            if (callback != NULL) {
+                                callback(query->id, (int64_t) p, data);
+                            }
+                        }
+                    }
+                }
+                query->phase = QUERY_DONE;
+                break;
+            }
+
+            case QUERY_DONE:
+                return 0;
+        }
+    }
+}
+
+static int compare_key(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+// Function to read blocks into the slots claimed for them, and add them to the cache
+static int read_blocks(ssd_index_t* ssd, block_read_t* reads, const uint64_t* keys, const int32_t* slots, size_t n_reads) {
+    if (block_io_read(&ssd->io, reads, n_reads) != 0) {
+        return -1;
+    }
+    for (size_t r = 0; r < n_reads; r++) {
+        size_t file_size = (keys[r] >> 63) == SSD_FILE_SA ? ssd->sa_file_size : ssd->text_file_size;
+        if (reads[r].offset >= file_size) {
+            return -1;
+        }
+        size_t expected = file_size - reads[r].offset < SSD_BLOCK_SIZE ? file_size - reads[r].offset : SSD_BLOCK_SIZE;
+        if (reads[r].result < (ssize_t) expected) {
+            return -1;
+        }
+        cache_insert(&ssd->cache, slots[r], keys[r], expected, ssd->round);
+    }
+    ssd->blocks_read += n_reads;
+    return 0;
+}
+
+// Function to read the blocks the waiting queries need, BLOCK_IO_DEPTH at a time. At most as many blocks
+// are read as the cache holds, the queries whose block is left out wait for the next round.
+static int fetch_blocks(ssd_index_t* ssd, uint64_t* wanted, size_t n_wanted, block_read_t* reads) {
+    qsort(wanted, n_wanted, sizeof(uint64_t), compare_key);
+    ssd->round++;
+
+    uint64_t keys[BLOCK_IO_DEPTH];
+    int32_t slots[BLOCK_IO_DEPTH];
+    size_t n_reads = 0;
+    for (size_t w = 0; w < n_wanted; w++) {
+        if (w > 0 && wanted[w] == wanted[w - 1]) {
+            continue;
+        }
+        int32_t slot = cache_claim(&ssd->cache, ssd->round);
+        if (slot == NO_SLOT) {
+            break;
+        }
+
+        uint64_t block = wanted[w] & ~((uint64_t) 1 << 63);
+        block_read_t read = { (wanted[w] >> 63) == SSD_FILE_SA ? ssd->sa_fd : ssd->text_fd, block * SSD_BLOCK_SIZE,
+            SSD_BLOCK_SIZE, ssd->cache.blocks + (size_t) slot * SSD_BLOCK_SIZE, 0 };
+        reads[n_reads] = read;
+        keys[n_reads] = wanted[w];
+        slots[n_reads] = slot;
+        if (++n_reads == BLOCK_IO_DEPTH) {
+            if (read_blocks(ssd, reads, keys, slots, n_reads) != 0) {
+                return -1;
+            }
+            n_reads = 0;
+        }
+    }
+    return n_reads > 0 ? read_blocks(ssd, reads, keys, slots, n_reads) : 0;
+}
+
+// Function to search a batch of patterns side by side, reporting the same hits as ssa_search on each of
+// them, in the same order for every pattern. The more patterns a batch has, the more blocks are read at
+// once, which keeps more reads in flight on the drive. `hits`, when given, receives the number of hits of
+// every pattern. Returns -1 if a read fails or memory runs out.
+int ssd_search_batch(ssd_index_t* ssd, const uint8_t* const* patterns, const size_t* pattern_lens, size_t n_patterns, ssd_hit_callback callback, void* data, size_t* hits) {
+    ssd_query_t* queries = calloc(n_patterns + 1, sizeof(ssd_query_t));
+    ssd_query_t** active = malloc((n_patterns + 1) * sizeof(ssd_query_t*));
+    uint64_t* keys = malloc((n_patterns + 1) * sizeof(uint64_t));
+    block_read_t* reads = malloc(BLOCK_IO_DEPTH * sizeof(block_read_t));
+    int failed = queries == NULL || active == NULL || keys == NULL || reads == NULL;
+
+    size_t n_active = 0;
+    for (size_t q = 0; q < n_patterns && !failed; q++) {
+        ssd_query_t* query = &queries[q];
+        query->id = q;
+        query->pattern = patterns[q];
+        query->pattern_len = pattern_lens[q];
+        query->phase = pattern_lens[q] > 0 ? QUERY_INTERVAL : QUERY_DONE;
+        // Room for the characters of a comparison and for the tail of the text
+        query->buffer = malloc((pattern_lens[q] > 256 ? pattern_lens[q] : 256) + 1);
+        failed = query->buffer == NULL;
+        active[n_active++] = query;
+    }
+
+    while (n_active > 0 && !failed) {
+        size_t n_keys = 0;
+        for (size_t a = 0; a < n_active;) {
+            if (step_query(ssd, active[a], callback, data)) {
+                keys[n_keys++] = active[a]->wanted;
+                a++;
+            } else {
+                active[a] = active[--n_active];
+            }
+        }
+        if (n_keys > 0) {
+            failed = fetch_blocks(ssd, keys, n_keys, reads) != 0;
+        }
+    }
+
+    for (size_t q = 0; queries != NULL && q < n_patterns; q++) {
+        if (hits != NULL) {
+            hits[q] = queries[q].hits;
+        }
+        free(queries[q].buffer);
+    }
+    free(queries);
+    free(active);
+    free(keys);
+    free(reads);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,70 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "strands.h"
+#include "bitpacking.h"
+#include "ssa_index.h"
+
+// Nucleotides in order of their rank, so the complement of rank r has rank 3 - r
+#define DNA_ALPHABET "ACGT"
+
+// Function to get the complement of a nucleotide. Other characters, such as N and separators, are kept.
+uint8_t complement_dna(uint8_t c) {
+    if (c != 'A' && c != 'C' && c != 'G' && c != 'T') {
+        return c;
+    }
+    return (uint8_t) DNA_ALPHABET[3 - get_rank_dna(c)];
+}
+
+// Function to follow every record of a text by its reverse complement, so R1-R2$ becomes
+// R1-rc(R1)-R2-rc(R2)$ and a single index covers both strands. Record 2i of the result is the forward
+// strand of record i, record 2i + 1 its reverse strand. The result always ends with a separator, also
+// when the text does not, so every record has the same layout. Returns NULL if memory runs out.
+uint8_t* add_reverse_complements(const uint8_t* text, size_t text_len, size_t* both_len) {
+    // Without a final separator, one separator is needed between the strands of the last record and one
+    // after them
+    uint8_t* both = malloc(2 * text_len + 3);
+    if (both == NULL) {
+        return NULL;
+    }
+
+    size_t out = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < text_len; i++) {
+        if (!ssa_is_separator(text[i]) && i + 1 < text_len) {
+            continue;
+        }
+
+        size_t end = ssa_is_separator(text[i]) ? i : i + 1;
+        memcpy(both + out, text + start, end - start);
+        out += end - start;
+        both[out++] = '-';
+        for (size_t j = end; j > start; j--) {
+            both[out++] = complement_dna(text[j - 1]);
+        }
+        both[out++] = ssa_is_separator(text[i]) ? text[i] : '$';
+        start = i + 1;
+    }
+
+    *both_len = out;
+    both[out] = '\0';
+    return both;
+}
+
+// Function to map a hit of a pattern in a text with both strands back to its original record and
+// strand. On the reverse strand, the offset is where the reverse complement of the pattern starts
+// on the forward strand.
+void strand_hit(const record_table_t* table, int64_t position, size_t pattern_len, strand_hit_t* hit) {
+    size_t record = record_of(table, position);
+    int64_t record_start = table->offsets[record];
+    int64_t record_len = table->offsets[record + 1] - record_start - 1;
+
+    hit->record = record / 2;
+    hit->reverse = record % 2;
+    hit->offset = position - record_start;
+    if (hit->reverse) {
+        hit->offset = record_len - hit->offset - (int64_t) pattern_len;
+    }
+}
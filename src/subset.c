@@ -0,0 +1,266 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "subset.h"
+
+// Function to read a whole file into a null-terminated buffer. Returns NULL if it cannot be read.
+static char* read_file(const char* fn, size_t* size) {
+    FILE* file = fopen(fn, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+    char* buffer = file_size >= 0 ? malloc((size_t) file_size + 1) : NULL;
+    if (buffer == NULL || fread(buffer, 1, (size_t) file_size, file) != (size_t) file_size) {
+        free(buffer);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    buffer[file_size] = '\0';
+    *size = (size_t) file_size;
+    return buffer;
+}
+
+static int compare_entry_name(const void* a, const void* b) {
+    return strcmp(((const fai_entry_t*) a)->name, ((const fai_entry_t*) b)->name);
+}
+
+// Function to parse the next tab-separated number of a line of a FASTA index. Returns -1 if there is none.
+static int parse_field(char** cursor, uint64_t* value) {
+    if (**cursor != '\t') {
+        return -1;
+    }
+    char* end;
+    *value = strtoull(*cursor + 1, &end, 10);
+    if (end == *cursor + 1) {
+        return -1;
+    }
+    *cursor = end;
+    return 0;
+}
+
+// Function to read a FASTA index, of which only the first five columns are used. Returns -1 if the
+// file cannot be read or a line is malformed.
+int read_fasta_index(const char* fai_fn, fasta_index_t* index) {
+    memset(index, 0, sizeof(fasta_index_t));
+    size_t size;
+    index->names = read_file(fai_fn, &size);
+    if (index->names == NULL) {
+        return -1;
+    }
+
+    size_t n_lines = 0;
+    for (size_t i = 0; i < size; i++) {
+        n_lines += index->names[i] == '\n';
+    }
+    index->entries = malloc((n_lines + 1) * sizeof(fai_entry_t));
+    if (index->entries == NULL) {
+        free_fasta_index(index);
+        return -1;
+    }
+
+    char* line = index->names;
+    while (*line != '\0') {
+        char* line_end = strchr(line, '\n');
+        if (line_end == NULL) {
+            line_end = line + strlen(line);
+        }
+        if (line_end == line || (line_end == line + 1 && *line == '\r')) {
+            line = *line_end == '\0' ? line_end : line_end + 1;
+            continue;
+        }
+
+        fai_entry_t* entry = &index->entries[index->n_entries];
+        char* cursor = strchr(line, '\t');
+        if (cursor == NULL || cursor > line_end || cursor == line) {
+            free_fasta_index(index);
+            return -1;
+        }
+        entry->name = line;
+        if (parse_field(&cursor, &entry->length) != 0 || parse_field(&cursor, &entry->offset) != 0
+                || parse_field(&cursor, &entry->line_bases) != 0 || parse_field(&cursor, &entry->line_width) != 0
+                || cursor > line_end || entry->line_bases == 0 || entry->line_width < entry->line_bases) {
+            free_fasta_index(index);
+            return -1;
+        }
+        *strchr(line, '\t') = '\0';
+        index->n_entries++;
+
+        line = *line_end == '\0' ? line_end : line_end + 1;
+    }
+
+    qsort(index->entries, index->n_entries, sizeof(fai_entry_t), compare_entry_name);
+    return 0;
+}
+
+void free_fasta_index(fasta_index_t* index) {
+    free(index->entries);
+    free(index->names);
+    memset(index, 0, sizeof(fasta_index_t));
+}
+
+// Function to find a record of a FASTA index by name. Returns NULL if there is no such record.
+const fai_entry_t* find_fasta_record(const fasta_index_t* index, const char* name) {
+    fai_entry_t key = { (char*) name, 0, 0, 0, 0 };
+    return bsearch(&key, index->entries, index->n_entries, sizeof(fai_entry_t), compare_entry_name);
+}
+
+// Function to read a list of record IDs, the first word of every non-empty line. A leading '>' is
+// dropped, so FASTA headers can be used as they are. Returns NULL if the file cannot be read.
+char** read_id_list(const char* ids_fn, size_t* n_ids) {
+    size_t size;
+    char* buffer = read_file(ids_fn, &size);
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    size_t n_lines = 1;
+    for (size_t i = 0; i < size; i++) {
+        n_lines += buffer[i] == '\n';
+    }
+    char** ids = malloc(n_lines * sizeof(char*));
+    if (ids == NULL) {
+        free(buffer);
+        return NULL;
+    }
+
+    *n_ids = 0;
+    char* cursor = buffer;
+    while (*cursor != '\0') {
+        while (*cursor != '\0' && *cursor != '\n' && isspace((unsigned char) *cursor)) {
+            cursor++;
+        }
+        if (*cursor == '>') {
+            cursor++;
+        }
+        size_t id_len = 0;
+        while (cursor[id_len] != '\0' && !isspace((unsigned char) cursor[id_len])) {
+            id_len++;
+        }
+        if (id_len > 0) {
+            ids[*n_ids] = strndup(cursor, id_len);
+            if (ids[*n_ids] == NULL) {
+                free_id_list(ids, *n_ids);
+                free(buffer);
+                return NULL;
+            }
+            (*n_ids)++;
+        }
+
+        char* line_end = strchr(cursor, '\n');
+        cursor = line_end == NULL ? cursor + strlen(cursor) : line_end + 1;
+    }
+
+    free(buffer);
+    return ids;
+}
+
+void free_id_list(char** ids, size_t n_ids) {
+    for (size_t i = 0; i < n_ids; i++) {
+        free(ids[i]);
+    }
+    free(ids);
+}
+
+// Function to find the end of the bytes a record takes in its FASTA file
+static uint64_t record_end(const fai_entry_t* entry) {
+    if (entry->length == 0) {
+        return entry->offset;
+    }
+    uint64_t last = entry->length - 1;
+    return entry->offset + last / entry->line_bases * entry->line_width + last % entry->line_bases + 1;
+}
+
+// Function to gather the sequences of the records with the given IDs from a FASTA file into a text, in
+// the order of the IDs, separated by '-' and ended by '$'. The file is memory-mapped and only the pages
+// of the selected records are read, using the offsets of the FASTA index. When `records` is given, it
+// receives the start of every record in the text. Returns NULL if an ID is not in the index, the index
+// does not match the file, or memory runs out.
+uint8_t* gather_records(const char* fasta_fn, const fasta_index_t* index, char** ids, size_t n_ids, size_t* length, record_table_t* records) {
+    const fai_entry_t** selected = malloc((n_ids + 1) * sizeof(fai_entry_t*));
+    if (selected == NULL) {
+        return NULL;
+    }
+    size_t text_len = 0;
+    for (size_t i = 0; i < n_ids; i++) {
+        selected[i] = find_fasta_record(index, ids[i]);
+        if (selected[i] == NULL) {
+            free(selected);
+            return NULL;
+        }
+        text_len += selected[i]->length + 1;
+    }
+
+    int fd = open(fasta_fn, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(selected);
+        return NULL;
+    }
+    uint8_t* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        free(selected);
+        return NULL;
+    }
+
+    uint8_t* text = malloc(text_len + 1);
+    int64_t* offsets = records != NULL ? malloc((n_ids + 1) * sizeof(int64_t)) : NULL;
+    int failed = text == NULL || (records != NULL && offsets == NULL);
+    for (size_t i = 0; i < n_ids && !failed; i++) {
+        failed = record_end(selected[i]) > (uint64_t) st.st_size;
+    }
+
+    // Announce the byte ranges of all records first, so the kernel reads them while the first ones are copied
+    long page_size = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < n_ids && !failed; i++) {
+        uint64_t start = selected[i]->offset / page_size * page_size;
+        madvise(map + start, record_end(selected[i]) - start, MADV_WILLNEED);
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < n_ids && !failed; i++) {
+        const fai_entry_t* entry = selected[i];
+        if (offsets != NULL) {
+            offsets[i] = (int64_t) out;
+        }
+        for (uint64_t copied = 0; copied < entry->length; copied += entry->line_bases) {
+            uint64_t line_len = entry->length - copied < entry->line_bases ? entry->length - copied : entry->line_bases;
+            memcpy(text + out, map + entry->offset + copied / entry->line_bases * entry->line_width, line_len);
+            out += line_len;
+        }
+        text[out++] = i + 1 < n_ids ? '-' : '$';
+    }
+    munmap(map, st.st_size);
+    free(selected);
+
+    if (failed) {
+        free(text);
+        free(offsets);
+        return NULL;
+    }
+
+    text[out] = '\0';
+    *length = out;
+    if (records != NULL) {
+        offsets[n_ids] = (int64_t) out;
+        records->offsets = offsets;
+        records->n_records = n_ids;
+    }
+    return text;
+}
@@ -0,0 +1,355 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "text_store.h"
+#include "ssa_index.h"
+
+#define TEXT_STORE_MAGIC "SSATXT2"
+// Characters decoded at a time when comparing, so a mismatch early on stops decoding
+#define COMPARE_CHUNK 64
+// Bits of a window that are always valid, whatever the bit offset of its first byte
+#define WINDOW_BITS 57
+
+#if TEXT_STORE_BLOCKS_PER_SUPERBLOCK * TEXT_STORE_BLOCK_SIZE * TEXT_STORE_MAX_CODE_LENGTH > 65536
+#error "A superblock is too long for 16-bit block offsets"
+#endif
+
+// Function to compute the lengths of a Huffman code for the given frequencies, by repeatedly joining
+// the two lightest trees. Returns the length of the longest code.
+static int huffman_code_lengths(const uint64_t* frequencies, uint8_t* code_lengths) {
+    uint64_t weights[511];
+    int parents[511];
+    int alive[511];
+    int n_nodes = 0;
+    int leaves[256];
+
+    memset(code_lengths, 0, 256);
+    for (int c = 0; c < 256; c++) {
+        if (frequencies[c] > 0) {
+            leaves[n_nodes] = c;
+            weights[n_nodes] = frequencies[c];
+            parents[n_nodes] = -1;
+            alive[n_nodes] = 1;
+            n_nodes++;
+        }
+    }
+    int n_leaves = n_nodes;
+    if (n_leaves == 0) {
+        return 0;
+    }
+    if (n_leaves == 1) {
+        code_lengths[leaves[0]] = 1;
+        return 1;
+    }
+
+    for (int joined = 0; joined < n_leaves - 1; joined++) {
+        int first = -1, second = -1;
+        for (int i = 0; i < n_nodes; i++) {
+            if (!alive[i]) {
+                continue;
+            }
+            if (first < 0 || weights[i] < weights[first]) {
+                second = first;
+                first = i;
+            } else if (second < 0 || weights[i] < weights[second]) {
+                second = i;
+            }
+        }
+        alive[first] = alive[second] = 0;
+        parents[first] = parents[second] = n_nodes;
+        weights[n_nodes] = weights[first] + weights[second];
+        parents[n_nodes] = -1;
+        alive[n_nodes] = 1;
+        n_nodes++;
+    }
+
+    int max_length = 0;
+    for (int i = 0; i < n_leaves; i++) {
+        int length = 0;
+        for (int node = i; parents[node] >= 0; node = parents[node]) {
+            length++;
+        }
+        code_lengths[leaves[i]] = (uint8_t) length;
+        if (length > max_length) {
+            max_length = length;
+        }
+    }
+    return max_length;
+}
+
+// Function to assign canonical codes to the code lengths and fill the decode table, which maps every
+// TEXT_STORE_MAX_CODE_LENGTH-bit prefix to its character and code length. Returns -1 if the lengths
+// do not form a prefix code.
+static int assign_codes(text_store_t* store) {
+    store->decode_table = calloc((size_t) 1 << TEXT_STORE_MAX_CODE_LENGTH, sizeof(uint16_t));
+    if (store->decode_table == NULL) {
+        return -1;
+    }
+
+    uint32_t code = 0;
+    for (int length = 1; length <= TEXT_STORE_MAX_CODE_LENGTH; length++) {
+        for (int c = 0; c < 256; c++) {
+            if (store->code_lengths[c] != length) {
+                continue;
+            }
+            store->codes[c] = (uint16_t) code;
+            uint32_t first = code << (TEXT_STORE_MAX_CODE_LENGTH - length);
+            uint32_t last = (code + 1) << (TEXT_STORE_MAX_CODE_LENGTH - length);
+            if (last > ((uint32_t) 1 << TEXT_STORE_MAX_CODE_LENGTH)) {
+                return -1;
+            }
+            for (uint32_t prefix = first; prefix < last; prefix++) {
+                store->decode_table[prefix] = (uint16_t) (c << 4 | length);
+            }
+            code++;
+        }
+        code <<= 1;
+    }
+    return 0;
+}
+
+static size_t n_blocks_of(size_t text_len) {
+    return (text_len + TEXT_STORE_BLOCK_SIZE - 1) / TEXT_STORE_BLOCK_SIZE;
+}
+
+static size_t n_superblocks_of(size_t n_blocks) {
+    return (n_blocks + TEXT_STORE_BLOCKS_PER_SUPERBLOCK - 1) / TEXT_STORE_BLOCKS_PER_SUPERBLOCK;
+}
+
+// Function to compress a text into a block-indexed store. Returns -1 if memory runs out.
+int text_store_build(text_store_t* store, const uint8_t* text, size_t text_len) {
+    memset(store, 0, sizeof(text_store_t));
+    store->text_len = text_len;
+
+    uint64_t frequencies[256] = {0};
+    for (size_t i = 0; i < text_len; i++) {
+        frequencies[text[i]]++;
+    }
+
+    // Flatten the distribution until the longest code fits the decode table. Halving keeps the
+    // order of the frequencies, so the code stays close to optimal.
+    while (huffman_code_lengths(frequencies, store->code_lengths) > TEXT_STORE_MAX_CODE_LENGTH) {
+        for (int c = 0; c < 256; c++) {
+            if (frequencies[c] > 0) {
+                frequencies[c] = (frequencies[c] >> 1) | 1;
+            }
+        }
+    }
+    if (assign_codes(store) != 0) {
+        return -1;
+    }
+
+    uint64_t total_bits = 0;
+    for (size_t i = 0; i < text_len; i++) {
+        total_bits += store->code_lengths[text[i]];
+    }
+
+    // The bits are padded with a full word, so decoding can always read 8 bytes at a time
+    store->n_blocks = n_blocks_of(text_len);
+    store->n_superblocks = n_superblocks_of(store->n_blocks);
+    store->bits_size = (total_bits + 7) / 8 + sizeof(uint64_t);
+    store->bits = calloc(store->bits_size, 1);
+    store->superblock_offsets = malloc((store->n_superblocks + 1) * sizeof(uint64_t));
+    store->block_offsets = malloc(store->n_blocks * sizeof(uint16_t));
+    if (store->bits == NULL || store->superblock_offsets == NULL || store->block_offsets == NULL) {
+        text_store_free(store);
+        return -1;
+    }
+
+    uint64_t bit_pos = 0;
+    for (size_t i = 0; i < text_len; i++) {
+        if (i % TEXT_STORE_BLOCK_SIZE == 0) {
+            size_t block = i / TEXT_STORE_BLOCK_SIZE;
+            if (block % TEXT_STORE_BLOCKS_PER_SUPERBLOCK == 0) {
+                store->superblock_offsets[block / TEXT_STORE_BLOCKS_PER_SUPERBLOCK] = bit_pos;
+            }
+            store->block_offsets[block] = (uint16_t) (bit_pos - store->superblock_offsets[block / TEXT_STORE_BLOCKS_PER_SUPERBLOCK]);
+        }
+        uint8_t length = store->code_lengths[text[i]];
+        uint16_t code = store->codes[text[i]];
+        for (int b = length - 1; b >= 0; b--, bit_pos++) {
+            store->bits[bit_pos >> 3] |= (uint8_t) (((code >> b) & 1) << (7 - (bit_pos & 7)));
+        }
+    }
+    store->superblock_offsets[store->n_superblocks] = bit_pos;
+
+    return 0;
+}
+
+// Function to read the 64 bits starting at a bit position, of which the first WINDOW_BITS are valid
+static inline uint64_t peek_bits(const uint8_t* bits, uint64_t bit_pos) {
+    const uint8_t* p = bits + (bit_pos >> 3);
+    uint64_t window = 0;
+    for (int i = 0; i < 8; i++) {
+        window = (window << 8) | p[i];
+    }
+    return window << (bit_pos & 7);
+}
+
+// Function to decode `n` characters from a bit position into `out`, or skip them if `out` is NULL.
+// Returns the bit position after the last decoded character.
+static uint64_t decode(const text_store_t* store, uint64_t bit_pos, size_t n, uint8_t* out) {
+    while (n > 0) {
+        uint64_t window = peek_bits(store->bits, bit_pos);
+        int used = 0;
+        while (n > 0 && used + TEXT_STORE_MAX_CODE_LENGTH <= WINDOW_BITS) {
+            uint16_t entry = store->decode_table[(window << used) >> (64 - TEXT_STORE_MAX_CODE_LENGTH)];
+            used += entry & 0xF;
+            if (out != NULL) {
+                *out++ = (uint8_t) (entry >> 4);
+            }
+            n--;
+        }
+        bit_pos += used;
+    }
+    return bit_pos;
+}
+
+// Function to find the bit position of a character, starting from the block it is in
+static uint64_t seek(const text_store_t* store, size_t position) {
+    size_t block = position / TEXT_STORE_BLOCK_SIZE;
+    uint64_t bit_pos = store->superblock_offsets[block / TEXT_STORE_BLOCKS_PER_SUPERBLOCK] + store->block_offsets[block];
+    return decode(store, bit_pos, position - block * TEXT_STORE_BLOCK_SIZE, NULL);
+}
+
+// Function to decode the substring of `len` characters at a position into `out`. The substring is cut off
+// at the end of the text, the number of extracted characters is returned.
+size_t text_store_extract(const text_store_t* store, size_t position, size_t len, uint8_t* out) {
+    if (position >= store->text_len) {
+        return 0;
+    }
+    if (len > store->text_len - position) {
+        len = store->text_len - position;
+    }
+
+    decode(store, seek(store, position), len, out);
+    return len;
+}
+
+// Function to compare the text at a position, cut off at the pattern length, with a pattern, as
+// packed_compare does. The text is decoded in chunks that are compared a word at a time, and decoding
+// stops at the first chunk with a mismatch.
+int text_store_compare(const text_store_t* store, size_t position, const uint8_t* pattern, size_t pattern_len, size_t* lcp) {
+    size_t available = position < store->text_len ? store->text_len - position : 0;
+    if (available > pattern_len) {
+        available = pattern_len;
+    }
+
+    uint8_t chunk[COMPARE_CHUNK];
+    uint64_t bit_pos = available > 0 ? seek(store, position) : 0;
+    size_t done = 0;
+    while (done < available) {
+        size_t n = available - done < COMPARE_CHUNK ? available - done : COMPARE_CHUNK;
+        bit_pos = decode(store, bit_pos, n, chunk);
+
+        size_t l = packed_lcp(chunk, n, pattern + done, n);
+        if (l < n) {
+            if (lcp != NULL) {
+                *lcp = done + l;
+            }
+            return chunk[l] < pattern[done + l] ? -1 : 1;
+        }
+        done += n;
+    }
+
+    if (lcp != NULL) {
+        *lcp = available;
+    }
+    return available < pattern_len ? -1 : 0;
+}
+
+// Function to compute the memory used by the store
+size_t text_store_size(const text_store_t* store) {
+    return sizeof(text_store_t) + store->bits_size + (store->n_superblocks + 1) * sizeof(uint64_t) + store->n_blocks * sizeof(uint16_t)
+        + ((size_t) 1 << TEXT_STORE_MAX_CODE_LENGTH) * sizeof(uint16_t);
+}
+
+// Function to write the store to a file: a magic string, the text length, the code lengths, the superblock
+// and block offsets and the bits. The codes follow from their lengths, so they are not stored.
+int text_store_write(const text_store_t* store, const char* output_fn) {
+    FILE* file = fopen(output_fn, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    uint64_t text_len = (uint64_t) store->text_len;
+    uint64_t bits_size = (uint64_t) store->bits_size;
+    int failed = fwrite(TEXT_STORE_MAGIC, 1, sizeof(TEXT_STORE_MAGIC), file) != sizeof(TEXT_STORE_MAGIC)
+        || fwrite(&text_len, sizeof(uint64_t), 1, file) != 1
+        || fwrite(store->code_lengths, 1, 256, file) != 256
+        || fwrite(store->superblock_offsets, sizeof(uint64_t), store->n_superblocks + 1, file) != store->n_superblocks + 1
+        || fwrite(store->block_offsets, sizeof(uint16_t), store->n_blocks, file) != store->n_blocks
+        || fwrite(&bits_size, sizeof(uint64_t), 1, file) != 1
+        || fwrite(store->bits, 1, store->bits_size, file) != store->bits_size;
+
+    if (fclose(file) != 0) {
+        failed = 1;
+    }
+    return failed ? -1 : 0;
+}
+
+// Function to load a store written by text_store_write. Returns -1 if the file cannot be read or is malformed.
+int text_store_load(text_store_t* store, const char* input_fn) {
+    memset(store, 0, sizeof(text_store_t));
+    FILE* file = fopen(input_fn, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char magic[sizeof(TEXT_STORE_MAGIC)];
+    uint64_t text_len = 0, bits_size = 0;
+    int failed = fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+        || memcmp(magic, TEXT_STORE_MAGIC, sizeof(magic)) != 0
+        || fread(&text_len, sizeof(uint64_t), 1, file) != 1
+        || fread(store->code_lengths, 1, 256, file) != 256;
+
+    for (int c = 0; c < 256 && !failed; c++) {
+        failed = store->code_lengths[c] > TEXT_STORE_MAX_CODE_LENGTH;
+    }
+
+    if (!failed) {
+        store->text_len = (size_t) text_len;
+        store->n_blocks = n_blocks_of(store->text_len);
+        store->n_superblocks = n_superblocks_of(store->n_blocks);
+        store->superblock_offsets = malloc((store->n_superblocks + 1) * sizeof(uint64_t));
+        store->block_offsets = malloc(store->n_blocks * sizeof(uint16_t));
+        failed = store->superblock_offsets == NULL || store->block_offsets == NULL
+            || fread(store->superblock_offsets, sizeof(uint64_t), store->n_superblocks + 1, file) != store->n_superblocks + 1
+            || fread(store->block_offsets, sizeof(uint16_t), store->n_blocks, file) != store->n_blocks
+            || fread(&bits_size, sizeof(uint64_t), 1, file) != 1
+            || bits_size < store->superblock_offsets[store->n_superblocks] / 8 + sizeof(uint64_t);
+        // Every block must start within its superblock, and the first one at the superblock itself
+        for (size_t b = 0; b < store->n_blocks && !failed; b++) {
+            size_t superblock = b / TEXT_STORE_BLOCKS_PER_SUPERBLOCK;
+            uint64_t start = store->superblock_offsets[superblock];
+            failed = start > store->superblock_offsets[superblock + 1]
+                || (b % TEXT_STORE_BLOCKS_PER_SUPERBLOCK == 0 ? store->block_offsets[b] != 0 : store->block_offsets[b] < store->block_offsets[b - 1])
+                || start + store->block_offsets[b] > store->superblock_offsets[superblock + 1];
+        }
+    }
+
+    if (!failed) {
+        store->bits_size = (size_t) bits_size;
+        store->bits = malloc(store->bits_size);
+        failed = store->bits == NULL
+            || fread(store->bits, 1, store->bits_size, file) != store->bits_size
+            || assign_codes(store) != 0;
+    }
+
+    fclose(file);
+    if (failed) {
+        text_store_free(store);
+        return -1;
+    }
+    return 0;
+}
+
+void text_store_free(text_store_t* store) {
+    free(store->bits);
+    free(store->superblock_offsets);
+    free(store->block_offsets);
+    free(store->decode_table);
+    memset(store, 0, sizeof(text_store_t));
+}
@@ -0,0 +1,321 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "warmup.h"
+
+#define ACCESS_PROFILE_MAGIC "SSAPRF2"
+#define MAX_THREADS 256
+
+// The part of the prefetching done by one thread: its share of the pages of every section, either the
+// hot ones or the remaining used ones
+typedef struct {
+    const access_profile_t* profile;
+    const ssa_reader_t* reader;
+    int hot;
+    int thread;
+    int n_threads;
+    size_t prefetched;
+} prefetch_task_t;
+
+static uint8_t* section_map(const ssa_reader_t* reader, int s, size_t* size) {
+    if (s == 0) {
+        *size = reader->sa_map_size;
+        return reader->sa_map;
+    }
+    *size = reader->text_map_size;
+    return reader->text_map;
+}
+
+static inline int get_bit(const uint8_t* bitmap, size_t i) {
+    return (bitmap[i / 8] >> (i % 8)) & 1;
+}
+
+static inline void set_bit(uint8_t* bitmap, size_t i, int value) {
+    bitmap[i / 8] = (uint8_t) ((bitmap[i / 8] & ~(1 << (i % 8))) | (value << (i % 8)));
+}
+
+static size_t bitmap_size(size_t n_pages) {
+    return (n_pages + 7) / 8;
+}
+
+// Function to allocate the bitmaps of all sections, for maps of the given sizes. Returns -1 if memory runs out.
+static int alloc_sections(access_profile_t* profile, const size_t* map_sizes) {
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS; s++) {
+        access_section_t* section = &profile->sections[s];
+        section->map_size = map_sizes[s];
+        section->n_pages = (map_sizes[s] + profile->page_size - 1) / profile->page_size;
+        section->used = calloc(bitmap_size(section->n_pages) + 1, 1);
+        section->hot = calloc(bitmap_size(section->n_pages) + 1, 1);
+        if (section->used == NULL || section->hot == NULL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to start recording which pages of the maps of a reader are read. A page trace is attached to
+// the index of the reader, so every search on it counts the pages of the SA and the text it reads. The
+// text of a reader opened on both strands is rebuilt in memory, so only its SA pages are counted. The
+// profile must stay in place until access_profile_free, which is called before the reader is closed.
+// Returns -1 if memory runs out.
+int access_profile_init(access_profile_t* profile, ssa_reader_t* reader) {
+    memset(profile, 0, sizeof(access_profile_t));
+    profile->page_size = (size_t) sysconf(_SC_PAGESIZE);
+
+    size_t map_sizes[ACCESS_PROFILE_SECTIONS];
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS; s++) {
+        profile->trace.bases[s] = section_map(reader, s, &map_sizes[s]);
+        profile->trace.sizes[s] = map_sizes[s];
+    }
+    profile->trace.page_size = profile->page_size;
+    if (alloc_sections(profile, map_sizes) != 0) {
+        access_profile_free(profile);
+        return -1;
+    }
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS; s++) {
+        profile->trace.counts[s] = calloc(profile->sections[s].n_pages + 1, sizeof(uint32_t));
+        if (profile->trace.counts[s] == NULL) {
+            access_profile_free(profile);
+            return -1;
+        }
+    }
+
+    profile->reader = reader;
+    reader->index.trace = &profile->trace;
+    return 0;
+}
+
+static int compare_counts_descending(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*) a;
+    uint32_t y = *(const uint32_t*) b;
+    return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+// Function to mark the pages read so far as used, and the most read ones, which together take half of all
+// reads, as hot. Called before the profile is written, or periodically while queries are served. Returns -1
+// if the profile is not recording or memory runs out.
+int access_profile_update(access_profile_t* profile) {
+    if (profile->reader == NULL) {
+        return -1;
+    }
+
+    size_t n_pages = 0;
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS; s++) {
+        n_pages += profile->sections[s].n_pages;
+    }
+    uint32_t* counts = malloc((n_pages + 1) * sizeof(uint32_t));
+    if (counts == NULL) {
+        return -1;
+    }
+
+    // Searches may go on while the counts are taken, which only makes the counts grow
+    size_t n_used = 0;
+    uint64_t reads = 0;
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS; s++) {
+        access_section_t* section = &profile->sections[s];
+        for (size_t page = 0; page < section->n_pages; page++) {
+            uint32_t count = __atomic_load_n(&profile->trace.counts[s][page], __ATOMIC_RELAXED);
+            set_bit(section->used, page, count > 0);
+            if (count > 0) {
+                counts[n_used++] = count;
+                reads += count;
+            }
+        }
+    }
+
+    // The hot pages are those read at least as often as the page at which half of all reads is reached
+    qsort(counts, n_used, sizeof(uint32_t), compare_counts_descending);
+    uint32_t threshold = UINT32_MAX;
+    uint64_t covered = 0;
+    for (size_t i = 0; i < n_used && 2 * covered < reads; i++) {
+        covered += counts[i];
+        threshold = counts[i];
+    }
+    free(counts);
+
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS; s++) {
+        access_section_t* section = &profile->sections[s];
+        for (size_t page = 0; page < section->n_pages; page++) {
+            set_bit(section->hot, page, get_bit(section->used, page)
+                && __atomic_load_n(&profile->trace.counts[s][page], __ATOMIC_RELAXED) >= threshold);
+        }
+    }
+    return 0;
+}
+
+// Function to write the bitmaps of a profile to a file, together with the page size and map sizes they
+// were recorded for
+int access_profile_write(const access_profile_t* profile, const char* output_fn) {
+    FILE* file = fopen(output_fn, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    uint64_t page_size = (uint64_t) profile->page_size;
+    int failed = fwrite(ACCESS_PROFILE_MAGIC, 1, sizeof(ACCESS_PROFILE_MAGIC), file) != sizeof(ACCESS_PROFILE_MAGIC)
+        || fwrite(&page_size, sizeof(uint64_t), 1, file) != 1;
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS && !failed; s++) {
+        const access_section_t* section = &profile->sections[s];
+        uint64_t map_size = (uint64_t) section->map_size;
+        size_t size = bitmap_size(section->n_pages);
+        failed = fwrite(&map_size, sizeof(uint64_t), 1, file) != 1
+            || fwrite(section->used, 1, size, file) != size
+            || fwrite(section->hot, 1, size, file) != size;
+    }
+
+    if (fclose(file) != 0) {
+        failed = 1;
+    }
+    return failed ? -1 : 0;
+}
+
+// Function to load a profile written by access_profile_write for the maps of a reader. Returns -1 if the
+// file cannot be read, is malformed, or was recorded for other files or another page size.
+int access_profile_load(access_profile_t* profile, const char* input_fn, const ssa_reader_t* reader) {
+    memset(profile, 0, sizeof(access_profile_t));
+    FILE* file = fopen(input_fn, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char magic[sizeof(ACCESS_PROFILE_MAGIC)];
+    uint64_t page_size = 0;
+    int failed = fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+        || memcmp(magic, ACCESS_PROFILE_MAGIC, sizeof(magic)) != 0
+        || fread(&page_size, sizeof(uint64_t), 1, file) != 1
+        || page_size != (uint64_t) sysconf(_SC_PAGESIZE);
+    profile->page_size = (size_t) page_size;
+
+    size_t map_sizes[ACCESS_PROFILE_SECTIONS];
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS; s++) {
+        section_map(reader, s, &map_sizes[s]);
+    }
+    if (!failed) {
+        failed = alloc_sections(profile, map_sizes) != 0;
+    }
+
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS && !failed; s++) {
+        access_section_t* section = &profile->sections[s];
+        uint64_t map_size = 0;
+        size_t size = bitmap_size(section->n_pages);
+        failed = fread(&map_size, sizeof(uint64_t), 1, file) != 1
+            || map_size != (uint64_t) section->map_size
+            || fread(section->used, 1, size, file) != size
+            || fread(section->hot, 1, size, file) != size;
+    }
+
+    fclose(file);
+    if (failed) {
+        access_profile_free(profile);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to prefetch the pages from `start` up to `end` of a section that are set in the bitmap. Every
+// run of consecutive pages is announced with MADV_WILLNEED, so the kernel reads it ahead in one go, and
+// then read, so it is mapped before the first query needs it. Returns the number of pages prefetched.
+static size_t prefetch_pages(const access_section_t* section, uint8_t* map, size_t page_size, int hot, size_t start, size_t end) {
+    const uint8_t* bitmap = hot ? section->hot : section->used;
+    volatile uint8_t sink = 0;
+    size_t prefetched = 0;
+
+    size_t page = start;
+    while (page < end) {
+        // Used pages that are hot were prefetched in the first pass
+        if (!get_bit(bitmap, page) || (!hot && get_bit(section->hot, page))) {
+            page++;
+            continue;
+        }
+        size_t run_end = page + 1;
+        while (run_end < end && get_bit(bitmap, run_end) && (hot || !get_bit(section->hot, run_end))) {
+            run_end++;
+        }
+
+        uint8_t* run = map + page * page_size;
+        size_t run_size = run_end * page_size > section->map_size
+            ? section->map_size - page * page_size : (run_end - page) * page_size;
+        madvise(run, run_size, MADV_WILLNEED);
+        for (size_t offset = 0; offset < run_size; offset += page_size) {
+            sink += run[offset];
+        }
+        prefetched += run_end - page;
+        page = run_end;
+    }
+    (void) sink;
+    return prefetched;
+}
+
+static void* prefetch_phase(void* data) {
+    prefetch_task_t* task = data;
+    const access_profile_t* profile = task->profile;
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS; s++) {
+        const access_section_t* section = &profile->sections[s];
+        size_t map_size;
+        uint8_t* map = section_map(task->reader, s, &map_size);
+        if (map == NULL || map_size != section->map_size) {
+            continue;
+        }
+        size_t start = section->n_pages * task->thread / task->n_threads;
+        size_t end = section->n_pages * (task->thread + 1) / task->n_threads;
+        task->prefetched += prefetch_pages(section, map, profile->page_size, task->hot, start, end);
+    }
+    return NULL;
+}
+
+// Function to prefetch the pages of a profile into the maps of a freshly opened reader with `n_threads`
+// threads: first the hot pages of all sections, then the other used ones. It returns when all pages
+// are mapped, so a server that should answer queries right away calls it from a thread of its own.
+// Returns the number of pages prefetched.
+size_t access_profile_prefetch(const access_profile_t* profile, const ssa_reader_t* reader, int n_threads) {
+    if (n_threads > MAX_THREADS) {
+        n_threads = MAX_THREADS;
+    }
+    if (n_threads < 1) {
+        n_threads = 1;
+    }
+
+    prefetch_task_t tasks[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS];
+    size_t prefetched = 0;
+    for (int hot = 1; hot >= 0; hot--) {
+        for (int t = 0; t < n_threads; t++) {
+            prefetch_task_t task = { profile, reader, hot, t, n_threads, 0 };
+            tasks[t] = task;
+        }
+
+        // The last task runs on the calling thread, as does a task whose thread cannot be started
+        for (int t = 0; t < n_threads - 1; t++) {
+            started[t] = pthread_create(&threads[t], NULL, prefetch_phase, &tasks[t]) == 0;
+            if (!started[t]) {
+                prefetch_phase(&tasks[t]);
+            }
+        }
+        prefetch_phase(&tasks[n_threads - 1]);
+        for (int t = 0; t < n_threads; t++) {
+            if (t < n_threads - 1 && started[t]) {
+                pthread_join(threads[t], NULL);
+            }
+            prefetched += tasks[t].prefetched;
+        }
+    }
+    return prefetched;
+}
+
+void access_profile_free(access_profile_t* profile) {
+    if (profile->reader != NULL && profile->reader->index.trace == &profile->trace) {
+        profile->reader->index.trace = NULL;
+    }
+    for (int s = 0; s < ACCESS_PROFILE_SECTIONS; s++) {
+        free(profile->sections[s].used);
+        free(profile->sections[s].hot);
+        free(profile->trace.counts[s]);
+    }
+    memset(profile, 0, sizeof(access_profile_t));
+}
@@ -0,0 +1,227 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "windows.h"
+
+// Longest q-gram of a bucket table, only reached for tiny alphabets
+#define BUCKET_TABLE_MAX_Q 32
+
+typedef struct {
+    window_hit_callback callback;
+    void* data;
+    size_t window;
+} window_hits_t;
+
+static int has_rank(const ssa_index_t* index, uint8_t c) {
+    return index->char_to_rank[c] != 0 || (index->alphabet_size > 0 && c == index->rank_to_char[0]);
+}
+
+// Function to build the bucket table of an index in one pass over the SA, with q as large as the maximum
+// number of buckets allows. Returns -1 if memory runs out.
+int bucket_table_build(const ssa_index_t* index, bucket_table_t* table) {
+    memset(table, 0, sizeof(bucket_table_t));
+    table->alphabet_size = index->alphabet_size > 0 ? index->alphabet_size : 1;
+    table->q = 1;
+    table->n_buckets = table->alphabet_size;
+    while (table->q < BUCKET_TABLE_MAX_Q && table->n_buckets * table->alphabet_size <= BUCKET_TABLE_MAX_BUCKETS) {
+        table->q++;
+        table->n_buckets *= table->alphabet_size;
+    }
+
+    table->starts = malloc((table->n_buckets + 1) * sizeof(size_t));
+    table->short_suffixes = malloc(table->q * sizeof(size_t));
+    table->short_texts = malloc(table->q * table->q);
+    table->text_len = index->text_len;
+    if (table->starts == NULL || table->short_suffixes == NULL || table->short_texts == NULL) {
+        bucket_table_free(table);
+        return -1;
+    }
+
+    // The keys of the suffixes in SA order never decrease, so a bucket starts after all suffixes with
+    // a smaller key. Suffixes shorter than q are not counted, only their positions are kept.
+    size_t next = 0;
+    size_t n_full = 0;
+    for (size_t i = 0; i < index->sa_length; i++) {
+        size_t p = (size_t) ssa_index_get(index, i);
+        if (p + table->q > index->text_len) {
+            if (table->n_short < table->q) {
+                memcpy(table->short_texts + table->n_short * table->q, index->text + p, index->text_len - p);
+                table->short_suffixes[table->n_short++] = p;
+            }
+            continue;
+        }
+
+        size_t key = 0;
+        for (size_t t = 0; t < table->q; t++) {
+            key = key * table->alphabet_size + index->char_to_rank[index->text[p + t]];
+        }
+        while (next <= key) {
+            table->starts[next++] = n_full;
+        }
+        n_full++;
+    }
+    while (next <= table->n_buckets) {
+        table->starts[next++] = n_full;
+    }
+    return 0;
+}
+
+void bucket_table_free(bucket_table_t* table) {
+    free(table->starts);
+    free(table->short_suffixes);
+    free(table->short_texts);
+    memset(table, 0, sizeof(bucket_table_t));
+}
+
+// Function to find the SA interval of the suffixes that start with a prefix of at most q characters,
+// whose key has the ranks of its characters as digits. The buckets only count the suffixes of at least
+// q characters, the few shorter ones are placed by comparing them with the prefix.
+void bucket_table_interval(const bucket_table_t* table, size_t key, const uint8_t* prefix, size_t prefix_len, search_interval_t* interval) {
+    size_t scale = 1;
+    for (size_t t = prefix_len; t < table->q; t++) {
+        scale *= table->alphabet_size;
+    }
+    interval->lower = table->starts[key * scale];
+    interval->upper = table->starts[(key + 1) * scale];
+
+    for (size_t s = 0; s < table->n_short; s++) {
+        const uint8_t* suffix = table->short_texts + s * table->q;
+        size_t suffix_len = table->text_len - table->short_suffixes[s];
+        size_t lcp = packed_lcp(suffix, suffix_len, prefix, prefix_len);
+        if (lcp == prefix_len) {
+            interval->upper++;
+        } else if (lcp == suffix_len || suffix[lcp] < prefix[lcp]) {
+            interval->lower++;
+            interval->upper++;
+        }
+    }
+}
+
+static void report_window_hit(int64_t position, void* data) {
+    window_hits_t* hits = data;
+    hits->callback(hits->window, position, hits->data);
+}
+
+// Function to report the occurrences of a window from the intervals of all of its offsets
+static size_t search_window(const ssa_index_t* index, const search_interval_t* intervals, const uint8_t* window, size_t window_len, window_hits_t* hits) {
+    size_t n_hits = 0;
+    size_t sparseness_factor = index->sparseness_factor > 0 ? index->sparseness_factor : 1;
+    for (size_t j = 0; j < sparseness_factor; j++) {
+        for (size_t i = intervals[j].lower; i < intervals[j].upper; i++) {
+            int64_t position;
+            if (!ssa_verify_hit(index, window, window_len, &intervals[j], ssa_index_get(index, i), &position)) {
+                continue;
+            }
+            n_hits++;
+            if (hits->callback != NULL) {
+                hits->callback(hits->window, position, hits->data);
+            }
+        }
+    }
+    return n_hits + ssa_search_tail(index, window, window_len, hits->callback != NULL ? report_window_hit : NULL, hits);
+}
+
+// Function to report the occurrences of every window of `window_len` characters of a sequence, as
+// ssa_search would for each window on its own, in order of the windows. Window i searches the sequence
+// from position i + j with its last character at i + window_len - 1 for every offset j, so the strings
+// searched from one position are prefixes of each other: the shortest is found in the buckets of its
+// first q characters, every longer one within the interval of the previous one, skipping the characters both
+// share. Returns the number of hits, or 0 if memory runs out.
+size_t ssa_search_windows(const ssa_index_t* index, const bucket_table_t* table, const uint8_t* sequence, size_t sequence_len, size_t window_len, window_hit_callback callback, void* data) {
+    size_t sparseness_factor = index->sparseness_factor > 0 ? index->sparseness_factor : 1;
+    if (window_len == 0 || sequence_len < window_len) {
+        return 0;
+    }
+
+    // The intervals of the last sparseness_factor positions, of which the interval with offset j belongs
+    // to the window that starts j positions earlier
+    search_interval_t* intervals = malloc(sparseness_factor * sparseness_factor * sizeof(search_interval_t));
+    search_interval_t* window_intervals = malloc(sparseness_factor * sizeof(search_interval_t));
+    if (intervals == NULL || window_intervals == NULL) {
+        free(intervals);
+        free(window_intervals);
+        return 0;
+    }
+
+    size_t last_window = sequence_len - window_len;
+    size_t max_offset = sparseness_factor - 1 < window_len - 1 ? sparseness_factor - 1 : window_len - 1;
+    size_t hits = 0;
+
+    // Rolling key of the q-gram at position p, valid if it has no characters outside the alphabet
+    size_t key = 0;
+    size_t valid_from = 0;
+    size_t key_end = 0;
+
+    for (size_t p = 0; p <= last_window + max_offset; p++) {
+        while (key_end < p + table->q && key_end < sequence_len) {
+            uint8_t c = sequence[key_end];
+            if (!has_rank(index, c)) {
+                valid_from = key_end + 1;
+            }
+            key = (key * table->alphabet_size + index->char_to_rank[c]) % table->n_buckets;
+            key_end++;
+        }
+        int key_valid = key_end == p + table->q && valid_from <= p;
+
+        // Offsets of the windows that need this position, from the shortest string to the longest
+        size_t j_lo = p > last_window ? p - last_window : 0;
+        size_t j_hi = p < max_offset ? p : max_offset;
+        search_interval_t* slot = intervals + (p % sparseness_factor) * sparseness_factor;
+        search_interval_t previous = { 0, index->sa_length, 0 };
+        size_t known_lcp = 0;
+        for (size_t j = j_hi + 1; j-- > j_lo;) {
+            size_t length = window_len - j;
+            if (j == j_hi) {
+                // Strings shorter than q are found in the range of all buckets they are a prefix of
+                size_t prefix_len = length < table->q ? length : table->q;
+                size_t prefix_key = key;
+                int prefix_valid = key_valid;
+                if (prefix_len < table->q) {
+                    prefix_key = 0;
+                    prefix_valid = 1;
+                    for (size_t t = 0; t < prefix_len; t++) {
+                        prefix_valid &= has_rank(index, sequence[p + t]);
+                        prefix_key = prefix_key * table->alphabet_size + index->char_to_rank[sequence[p + t]];
+                    }
+                }
+                if (prefix_valid) {
+                    bucket_table_interval(table, prefix_key, sequence + p, prefix_len, &previous);
+                } else {
+                    previous.lower = previous.upper = 0;
+                }
+                known_lcp = prefix_len;
+            }
+
+            search_interval_t* interval = &slot[j];
+            interval->lower = ssa_search_bound(index, previous.lower, previous.upper, sequence + p, length, SEARCH_LCP, known_lcp, 0);
+            interval->upper = ssa_search_bound(index, interval->lower, previous.upper, sequence + p, length, SEARCH_LCP, known_lcp, 1);
+            interval->offset = j;
+            previous = *interval;
+            known_lcp = length;
+        }
+
+        if (p < max_offset) {
+            continue;
+        }
+
+        // Window p - max_offset has all of its intervals now
+        size_t window = p - max_offset;
+        for (size_t j = 0; j < sparseness_factor; j++) {
+            if (j <= max_offset) {
+                window_intervals[j] = intervals[((window + j) % sparseness_factor) * sparseness_factor + j];
+            } else {
+                // Sampled suffixes past the end of the window only need their prefix verified
+                search_interval_t all = { 0, index->sa_length, j };
+                window_intervals[j] = all;
+            }
+        }
+        window_hits_t window_hits = { callback, data, window };
+        hits += search_window(index, window_intervals, sequence + window, window_len, &window_hits);
+    }
+
+    free(intervals);
+    free(window_intervals);
+    return hits;
+}